@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "framebuffer.h"
+#include "primitive.h"
+
+// ----------------- Auxiliary outputs (AOVs) -----------------
+// Data of the primary hit, or the cost of tracing each pixel, rendered in
+// the same pass as the beauty image and written next to it as float
+// <stem>_<name>.pfm files. Enabled per scene with e.g.
+//   aovs: depth normal albedo primitive cycles tests
+enum class Aov {
+    Depth,       // distance from the camera; infinity on a miss
+    Normal,      // shading normal, facing the camera; 0 on a miss
+    Albedo,      // material diffuse color; 0 on a miss
+    Primitive,   // index as in intersectPrimitive (exact below 2^24); -1 on a miss
+    Cycles,      // cycle counter ticks spent on the pixel (CycleCount)
+    Tests,       // ray-primitive tests of all the pixel's rays (RenderStats)
+    Count
+};
+static constexpr int AOV_COUNT = static_cast<int>(Aov::Count);
+
+const char* AovName(Aov a);
+PixelFormat AovFormat(Aov a);   // RGB32F for normal and albedo, R32F otherwise
+
+// Cost AOVs also get a false-color heatmap
+bool IsCostAov(Aov a);
+
+// <imgName without extension>_<name><ext>
+std::string AovFileName(const std::string& imgName, Aov a, const char* ext = ".pfm");
+
+// Write an R32F cost buffer as an RGBA8 PNG heatmap: log scale from the
+// 1st to the 99th percentile, black through red and yellow to white
+bool WriteHeatmap(const Framebuffer& fb, const std::string& fname);
+
+// AOV framebuffers of one render target, indexed by Aov; null entries are off
+struct AovBuffers {
+    Framebuffer* fb[AOV_COUNT] = {};
+
+    bool any() const {
+        for (Framebuffer* f : fb) if (f) return true;
+        return false;
+    }
+
+    bool cost() const {
+        return fb[static_cast<int>(Aov::Cycles)] || fb[static_cast<int>(Aov::Tests)];
+    }
+
+    // hit is null for a primary ray that missed
+    void store(int x, int y, const HitInfo* hit) const;
+
+    // Cost of work done for pixel (x, y); add accumulates onto an earlier
+    // pass over the same pixel
+    void storeCost(int x, int y, uint64_t cycles, uint64_t tests, bool add = false) const;
+};
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include "types.h"
+
+// Storage of one framebuffer pixel
+enum class PixelFormat {
+    RGBA8,    // 8-bit per channel, quantized like Image::toBytes; LDR outputs
+    RGB32F,   // raw float radiance (pfm, exr)
+    R32F      // one float per pixel (scalar AOVs)
+};
+
+// Pixel format an output file name needs (by extension)
+PixelFormat PixelFormatFor(const std::string& fname);
+
+inline size_t PixelBytes(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::RGBA8:  return 4;
+        case PixelFormat::RGB32F: return 3 * sizeof(float);
+        default:                  return sizeof(float);
+    }
+}
+
+// Row alignment of framebuffer storage, in bytes
+static constexpr size_t FRAMEBUFFER_ALIGN = 64;
+
+// Framebuffers larger than this live in a memory-mapped scratch file on
+// local disk instead of anonymous memory, so the kernel can write finished
+// rows back and a gigapixel film does not have to fit in RAM
+static constexpr size_t FRAMEBUFFER_MMAP_BYTES = size_t(1) << 30;
+
+// Directory for mapped framebuffers ($TMPDIR, else /tmp, unless set)
+void SetFramebufferScratchDir(const std::string& dir);
+
+// ----------------- Framebuffer -----------------
+// Row-major, tightly packed rows in one aligned allocation. Ranks shade
+// straight into it, MPI gathers into rank 0's instance in place and the
+// encoder reads it without another copy.
+struct Framebuffer {
+    int width, height;
+    PixelFormat format;
+    uint8_t* data;
+    bool mapped = false;   // data is an mmap of an unlinked scratch file
+
+    Framebuffer(int w, int h, PixelFormat format);
+    ~Framebuffer();
+
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+
+    size_t pixelBytes() const { return PixelBytes(format); }
+    size_t rowBytes() const { return pixelBytes() * width; }
+    size_t bytes() const { return rowBytes() * height; }
+    uint8_t* row(int y) { return data + rowBytes() * y; }
+    const uint8_t* row(int y) const { return data + rowBytes() * y; }
+
+    // Stores c the way the float gather + Image::write path did: rounded
+    // to float first, then (for RGBA8) clamped to 1 and scaled to 0..255.
+    // R32F keeps c.r only.
+    void setPixel(int x, int y, const Color& c) {
+        float r = static_cast<float>(c.r);
+        float g = static_cast<float>(c.g);
+        float b = static_cast<float>(c.b);
+        if (format == PixelFormat::RGBA8) {
+            uint8_t* px = data + (static_cast<size_t>(y) * width + x) * 4;
+            px[0] = uint8_t(fmin(r, 1) * 255);
+            px[1] = uint8_t(fmin(g, 1) * 255);
+            px[2] = uint8_t(fmin(b, 1) * 255);
+            px[3] = 255;
+        } else if (format == PixelFormat::RGB32F) {
+            float* px = reinterpret_cast<float*>(data) + (static_cast<size_t>(y) * width + x) * 3;
+            px[0] = r;
+            px[1] = g;
+            px[2] = b;
+        } else {
+            reinterpret_cast<float*>(data)[static_cast<size_t>(y) * width + x] = r;
+        }
+    }
+
+    // Encode by extension like Image::write (png, jpg, tga, bmp, ppm, pfm, exr)
+    void write(const char* fname) const;
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <mpi.h>
+#include "framebuffer.h"
+
+// ----------------- Row gather -----------------
+// Ranks send their rows to rank 0 in chunks of GATHER_CHUNK_ROWS while
+// they trace the next chunk. Rank 0 keeps GATHER_RECV_WINDOW receives
+// posted per rank and layer and drains them between its own chunks.
+static constexpr int GATHER_CHUNK_ROWS  = 32;
+static constexpr int GATHER_RECV_WINDOW = 2;
+
+// Row bytes a rank had to deliver to rank 0, and the bytes it actually sent
+struct GatherTraffic {
+    uint64_t raw_bytes = 0;
+    uint64_t sent_bytes = 0;
+};
+
+// Gathers every rank's rows of each layer (the image and its AOVs) into
+// rank 0's framebuffers, which hold the whole image. Other ranks' layers
+// hold only their own block. counts and displs are in rows; rank 0's own
+// block starts at row 0 and is traced in place.
+//
+// With compress, each chunk is RLE-encoded (rowCodec.h) unless that would
+// not shrink it; the receiver tells the two apart by the message size.
+class RowGather {
+public:
+    RowGather(const std::vector<Framebuffer*>& layers, const std::vector<int>& counts,
+              const std::vector<int>& displs, MPI_Comm comm, bool compress);
+    ~RowGather();
+
+    // Local rows [row, row + n) are final in every layer. Must be called for
+    // consecutive chunks of GATHER_CHUNK_ROWS (the last may be shorter).
+    // Other ranks send the chunk; rank 0 stores chunks that have arrived.
+    void send(int row, int n);
+
+    // Complete every transfer. False if a chunk could not be decoded.
+    bool finish();
+
+    GatherTraffic traffic;
+
+private:
+    struct Slot {
+        int source, layer, chunk;
+        std::vector<uint8_t> buffer;   // encoded chunk, with compress
+    };
+
+    int chunkCount(int r) const;
+    void postRecv(size_t s);
+    void store(size_t s, const MPI_Status& status);
+    void drain(bool block);
+
+    std::vector<Framebuffer*> layers;
+    std::vector<int> counts, displs;
+    MPI_Comm comm;
+    bool compress;
+    int rank = 0, size = 1;
+    bool ok = true;
+
+    // Rank 0: one slot per posted receive, next chunk to post per rank/layer
+    std::vector<Slot> slots;
+    std::vector<MPI_Request> recvs;
+    std::vector<int> next_chunk;
+    int pending = 0;
+
+    // Other ranks: sends in flight and the encoded chunks they read from
+    std::vector<MPI_Request> sends;
+    std::deque<std::vector<uint8_t>> encoded;
+};
+
+// ----------------- Two-level gather -----------------
+// Ranks are renumbered node by node, so every node traces one contiguous
+// block of rows. Ranks send chunks to their node leader over the
+// shared-memory communicator while they trace, raw unless compress_node.
+// Once a node's block is complete, its leader sends it to rank 0,
+// compressed if asked. Rank 0 then receives one block per node instead of
+// one per rank. On a single node rank 0 is the only leader, so only the
+// first level carries rows.
+//
+// With flat, every rank sends to rank 0 directly (one RowGather).
+class NodeGather {
+public:
+    NodeGather(MPI_Comm comm, bool flat);
+    ~NodeGather();
+
+    // Position and count in node-major order; split rows by these
+    int rank() const { return ordered_rank; }
+    int size() const { return ordered_size; }
+    int nodes() const { return node_count; }
+
+    // Rows this rank's framebuffers must hold: the whole image on rank 0,
+    // its node's block on the other leaders, its own rows elsewhere
+    int bufferRows(const std::vector<int>& counts) const;
+
+    // counts and displs in rows, per rank in node-major order. compress
+    // applies to the leaders' blocks (every chunk if flat), compress_node
+    // also to the chunks sent to the leaders.
+    void start(const std::vector<Framebuffer*>& layers, const std::vector<int>& counts,
+               const std::vector<int>& displs, bool compress, bool compress_node);
+    void send(int row, int n) { local->send(row, n); }
+    bool finish();
+
+    // Bytes that reached rank 0: from the leaders, or from every rank if flat
+    GatherTraffic traffic;
+    // Bytes ranks sent to their node leader; zero if flat
+    GatherTraffic node_traffic;
+
+private:
+    MPI_Comm ordered = MPI_COMM_NULL;
+    MPI_Comm node    = MPI_COMM_NULL;
+    MPI_Comm leaders = MPI_COMM_NULL;   // node rank 0s only
+    int ordered_rank = 0, ordered_size = 1;
+    int node_first = 0, node_size = 1;  // node's ranks in ordered
+    int node_count = 1;
+    bool flat, compress = true;
+
+    std::vector<Framebuffer*> layers;
+    std::vector<int> counts, displs;
+    std::unique_ptr<RowGather> local;
+};
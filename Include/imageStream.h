@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "framebuffer.h"
+
+// ----------------- Image streams -----------------
+// Sequential top-to-bottom row sinks for the formats that can be written
+// while the image is still being rendered (ppm, pfm, exr, png). Rows are passed
+// in the framebuffer layout of PixelFormatFor(fname).
+class ImageStream {
+public:
+    virtual ~ImageStream() {}
+
+    // Append the next n rows (tightly packed)
+    virtual bool writeRows(const uint8_t* rows, int n) = 0;
+
+    // Finish the file; false if any write failed
+    virtual bool close() = 0;
+};
+
+// ----------------- Raw rasters (ppm, pfm) -----------------
+// A text header followed by fixed-size rows, so every row's file offset is
+// known before any pixel is rendered. ppm rows are 8-bit RGB top to bottom
+// (from RGBA8); pfm rows are little-endian float RGB (from RGB32F) or
+// grayscale (from R32F) stored bottom to top.
+bool IsRasterFormat(const std::string& fname);
+std::string RasterHeader(const std::string& fname, PixelFormat format, int width, int height);
+size_t RasterRowBytes(const std::string& fname, PixelFormat format, int width);
+
+// Index in the file of image row y
+int RasterFileRow(const std::string& fname, int y, int height);
+
+// One framebuffer row of the given format in its file layout
+void PackRasterRow(const std::string& fname, PixelFormat format,
+                   const uint8_t* row, int width, uint8_t* out);
+
+// Whether fname's extension has a streaming writer
+bool ImageStreamSupported(const std::string& fname);
+
+// Null if the extension has no streaming writer or the file cannot be opened
+std::unique_ptr<ImageStream> OpenImageStream(const char* fname, int width, int height);
@@ -12,3 +12,13 @@ double intersectSphere(const Ray &ray, const Sphere &s);
 double rayTriangleIntersect(const Ray &ray, const Triangle &triangle);
 
 bool FindIntersection(const Scene& scene, const Ray &ray, HitInfo &hit);
+
+// Primitive index used by occlusion queries: index < spheres.size() is
+// scene.spheres[index], otherwise scene.triangles[index - spheres.size()].
+// Returns distance to intersection or infinity if no hit.
+double intersectPrimitive(const Scene& scene, const Ray &ray, int index);
+
+// Shadow query: true if any primitive is hit at a distance in
+// (1e-4, max_distance). Stops at the first such hit and stores its
+// primitive index in occluder.
+bool FindOcclusion(const Scene& scene, const Ray &ray, double max_distance, int &occluder);
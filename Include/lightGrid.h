@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include "types.h"
+#include "lighting.h"
+
+struct Scene;
+
+// Screen tiles (LIGHT_TILE x LIGHT_TILE pixels) get their own light list
+// for primary hits; secondary hits use the coarse 3D grid.
+static constexpr int LIGHT_TILE = 16;
+
+// Longest grid axis has this many cells; the others are proportional.
+static constexpr int LIGHT_GRID_RES = 16;
+
+// ----------------- Light grid -----------------
+// Deterministic many-light culling. Each point/spot light gets an
+// influence radius from light_cutoff on its color / d^2 falloff; lists of
+// the lights that can reach a region are built for screen tiles (from
+// the tile's primary hit points) and for the cells of a coarse grid over
+// the scene. Lists keep scene order and always contain directional lights.
+struct LightGrid {
+    std::vector<const Light*> lights;   // scene order
+    std::vector<Point3>       centers;  // per light (unused for directional)
+    std::vector<double>       radius2;  // per light, infinity for directional
+
+    // grid over the bounds of all primitives, lists stored CSR-style
+    Point3 bmin, bmax;
+    int nx = 0, ny = 0, nz = 0;
+    Direction3 cellSize;
+    std::vector<int>          cellStart;   // nx*ny*nz + 1 offsets
+    std::vector<const Light*> cellLights;
+
+    bool empty() const { return lights.empty(); }
+
+    void build(const Scene& scene);
+
+    // Lights that can reach some point of the box [lo, hi], in scene order
+    void lightsInBox(const Point3& lo, const Point3& hi,
+                     std::vector<const Light*>& out) const;
+
+    // Grid cell list for p, or false if p is outside the grid
+    bool cellLightsAt(const Point3& p, const Light* const*& begin,
+                      const Light* const*& end) const;
+};
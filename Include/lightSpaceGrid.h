@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include "types.h"
+#include "ray.h"
+
+struct Scene;
+
+// ----------------- Light-space occluder grid -----------------
+// For a directional light every shadow ray has the same direction, so a
+// whole ray projects to a single point on the plane perpendicular to it.
+// Primitives are binned by their projected bounds on that plane once per
+// render; a shadow query then only tests the primitives of one cell.
+struct LightSpaceGrid {
+    Direction3 u, v;          // orthonormal basis of the projection plane
+    double umin = 0, vmin = 0;
+    double cellU = 1, cellV = 1;
+    int nu = 0, nv = 0;
+
+    // CSR cell lists of primitive indices (see intersectPrimitive)
+    std::vector<int> cellStart;
+    std::vector<int> items;
+
+    bool empty() const { return cellStart.empty(); }
+
+    // L: direction towards the light, shared by all its shadow rays
+    void build(const Scene& scene, const Direction3& L);
+
+    // True if a primitive is hit along ray (whose direction is L) at a
+    // distance in (1e-4, max_distance); its index is stored in occluder
+    bool occluded(const Scene& scene, const Ray& ray, double max_distance,
+                  int& occluder) const;
+};
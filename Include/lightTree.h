@@ -0,0 +1,87 @@
+#pragma once
+#include <vector>
+#include "types.h"
+#include "lighting.h"
+#include "stats.h"
+
+// The tree is built when light sampling is requested, or when a
+// light_cutoff is set and the scene has at least this many point/spot
+// lights; otherwise shading loops over Scene::lights.
+static constexpr int LIGHT_TREE_MIN_LIGHTS = 16;
+
+// ----------------- Light tree node -----------------
+// Bounds everything below it: positions (AABB), emission directions
+// (cone of half-angle theta_o around axis, widened by theta_e) and power.
+struct LightTreeNode {
+    Point3     bmin, bmax;
+    Direction3 axis;
+    double     theta_o;
+    double     theta_e;
+    double     power;       // sum of the max color channel of the lights
+    bool       cone_limited;  // theta_o + theta_e < pi
+    double     cos_reach;     // cos(theta_o + theta_e)
+
+    int left  = -1;         // child node indices, -1 for leaves
+    int right = -1;
+    const Light* light = nullptr;   // leaves hold exactly one light
+};
+
+// ----------------- Light tree -----------------
+// Hierarchy over the point and spot lights of a scene. Directional lights
+// have no position and are kept aside in 'infinite'.
+struct LightTree {
+    std::vector<LightTreeNode> nodes;   // nodes[0] is the root
+    std::vector<const Light*>  infinite;
+
+    bool empty() const { return nodes.empty(); }
+
+    void build(const std::vector<Light*>& lights);
+
+    // Upper bound of the unshadowed radiance the lights below node can
+    // deliver to p, times the cosine term when 'cosine' is set.
+    double bound(const LightTreeNode& node, const Point3& p,
+                 const Direction3& N, bool cosine) const;
+
+    // Importance of node for shading p, used for stochastic selection.
+    double importance(const LightTreeNode& node, const Point3& p,
+                      const Direction3& N, bool cosine) const;
+
+    // Call f(light) for every bounded light whose bound (scaled by the
+    // material reflectance) is above cutoff; whole subtrees are skipped.
+    template <class F>
+    void forEachLight(const Point3& p, const Direction3& N, bool cosine,
+                      double reflectance, double cutoff, F&& f) const;
+
+    // Pick one bounded light with probability proportional to importance.
+    // u is uniform in [0,1). Returns nullptr if no light can reach p.
+    const Light* sample(const Point3& p, const Direction3& N, bool cosine,
+                        double u, double& pdf) const;
+};
+
+template <class F>
+void LightTree::forEachLight(const Point3& p, const Direction3& N, bool cosine,
+                             double reflectance, double cutoff, F&& f) const
+{
+    if (nodes.empty()) return;
+
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const LightTreeNode& node = nodes[stack[--top]];
+        STAT_INC(light_tree_nodes);
+
+        if (bound(node, p, N, cosine) * reflectance <= cutoff) {
+            STAT_INC(light_tree_pruned);
+            continue;
+        }
+
+        if (node.light) {
+            f(*node.light);
+        } else {
+            stack[top++] = node.right;
+            stack[top++] = node.left;
+        }
+    }
+}
@@ -1,29 +1,64 @@
 #pragma once
+#include <vector>
 #include "types.h"
 #include "ray.h"
+#include "primitive.h"
+#include "lightSpaceGrid.h"
 
 struct Scene;
 
+// Position and emission cone of a light, used to build the light tree
+struct LightBounds {
+    Point3     position;
+    Direction3 axis;      // emission cone axis
+    double     theta_o;   // cone half-angle in radians (pi: all directions)
+    double     theta_e;   // falloff half-angle beyond theta_o
+    double     power;     // max color channel
+};
+
 struct Light {
     Color color;
+    int id = -1;   // index in Scene::lights
 
     Light(Color color): color(color) {}
-    virtual Color getContribution(const Scene& scene, const Ray& ray, HitInfo& hit)  = 0;
+
+    // Light as seen from surface point p: unit direction towards the light,
+    // distance to it (infinity for directional lights) and the unoccluded
+    // radiance arriving at p. Returns false if p is outside the light's
+    // reach (e.g. outside a spot cone), in which case radiance is unset.
+    virtual bool illuminate(const Point3& p, Direction3& L, double& distance, Color& radiance) const = 0;
+
+    // Fills b for lights with a position; false for lights at infinity
+    virtual bool getBounds(LightBounds& b) const { (void)b; return false; }
+
+    // Build per-light acceleration data once the scene is loaded
+    virtual void prepare(const Scene& scene) { (void)scene; }
+
+    // Shadow test: is anything hit along shadowRay before distance? The
+    // blocking primitive's index (see intersectPrimitive) goes to occluder.
+    virtual bool occluded(const Scene& scene, const Ray& shadowRay, double distance, int& occluder) const;
+
+    // Shadowed Blinn-Phong contribution of this light at a hit
+    Color getContribution(const Scene& scene, const Ray& ray, HitInfo& hit) const;
     virtual ~Light() = default;
 };
 
 struct DirectionalLight: public Light{
     Direction3 direction;
+    LightSpaceGrid occluders;   // primitives binned along the light direction
 
     DirectionalLight(Color color, Direction3 direction): Light(color), direction(direction) {}
-    Color getContribution(const Scene& scene, const Ray& ray, HitInfo& hit);
+    bool illuminate(const Point3& p, Direction3& L, double& distance, Color& radiance) const override;
+    void prepare(const Scene& scene) override;
+    bool occluded(const Scene& scene, const Ray& shadowRay, double distance, int& occluder) const override;
 };
 
 struct PointLight: public Light{
     Point3 position;
 
     PointLight(Color color, Point3 position): Light(color), position(position) {}
-    Color getContribution(const Scene& scene, const Ray& ray, HitInfo& hit);
+    bool illuminate(const Point3& p, Direction3& L, double& distance, Color& radiance) const override;
+    bool getBounds(LightBounds& b) const override;
 };
 
 struct SpotLight: public Light{
@@ -33,10 +68,18 @@ struct SpotLight: public Light{
     double angle2;
 
     SpotLight(Color color, Point3 position, Direction3 direction, double angle1, double angle2): Light(color), position(position), direction(direction), angle1(angle1), angle2(angle2) {}
-    Color getContribution(const Scene& scene, const Ray& ray, HitInfo& hit);
+    bool illuminate(const Point3& p, Direction3& L, double& distance, Color& radiance) const override;
+    bool getBounds(LightBounds& b) const override;
 };
 
+// Forget the per-thread last-occluder cache; call before each tile (or
+// band of rows) and whenever the scene changes
+void ResetShadowCache(const Scene& scene);
+
+// lights: optional precomputed list (e.g. a screen tile's) to shade
+// instead of looking lights up per hit
 Color ApplyLighting(const Scene& scene,
                     Ray &ray,
                     HitInfo &hit,
-                    int depth);
\ No newline at end of file
+                    int depth,
+                    const std::vector<const Light*>* lights = nullptr);
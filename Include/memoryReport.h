@@ -0,0 +1,32 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include "render.h"
+
+// ----------------- Memory accounting -----------------
+// Bytes held by each part of the renderer, per rank. Scene data is sized
+// at report time from the containers that hold it (object sizes and vector
+// capacities, without allocator overhead). Framebuffers come and go during
+// the render, so they are counted as they are allocated and their peak is
+// reported.
+struct MemoryCounter {
+    uint64_t current = 0;
+    uint64_t peak = 0;
+
+    void add(size_t n) {
+        current += n;
+        peak = std::max(peak, current);
+    }
+    void remove(size_t n) { current -= n; }
+};
+
+// Framebuffers in anonymous memory, and those mapped from scratch files
+extern MemoryCounter g_framebuffer_memory;
+extern MemoryCounter g_mapped_framebuffer_memory;
+
+// Print bytes per component (min/mean/max over ranks), heap in use, peak
+// RSS per rank and summed per node, and a one-line JSON summary
+// ([MEMORY][JSON]) with the per-rank values. Collective over
+// MPI_COMM_WORLD; call while ctx and its scene are alive.
+void ReportMemory(const RenderContext& ctx, int world_rank);
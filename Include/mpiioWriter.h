@@ -0,0 +1,14 @@
+#pragma once
+#include <string>
+#include <mpi.h>
+#include "framebuffer.h"
+
+// ----------------- MPI-IO raster output -----------------
+// Every rank writes its own block of rows of a ppm/pfm straight into the
+// shared file with one collective MPI_File_write_at_all, so nothing is
+// gathered and assembly scales with the filesystem rather than rank 0.
+//
+// fb holds global rows [row0, row0 + rows). Collective over comm; returns
+// false on every rank if any rank failed. fname must satisfy IsRasterFormat.
+bool WriteRasterMPIIO(const std::string& fname, const Framebuffer& fb,
+                      int row0, int rows, int img_height, MPI_Comm comm);
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include "timing.h"
+
+// ----------------- Hardware counters -----------------
+// With --perf, each rank counts user-space hardware events of its main
+// thread with perf_event_open (Linux): cycles, instructions, L1d read
+// misses, last-level cache misses and branch misses. Where the PMU is not
+// available (e.g. most VMs) task-clock is counted instead.
+//
+// Counters are read at every phase switch and whenever a KernelScope
+// starts or ends. The difference is charged to the current phase and to
+// the innermost current kernel, the way PhaseScope charges time. The cost
+// of a read is measured at start and subtracted once per charged interval.
+enum class Kernel {
+    Other,
+    Intersect,   // FindIntersection: closest hit of camera and secondary rays
+    Shade,       // ShadeLight (Light::getContribution): one light at one hit
+    Occlusion,   // Shadowed: the shadow ray of a light evaluation
+    Count
+};
+static constexpr int KERNEL_COUNT = static_cast<int>(Kernel::Count);
+
+inline constexpr const char* KERNEL_NAMES[KERNEL_COUNT] = {
+    "other", "intersect", "shade", "occlusion"
+};
+
+enum class PerfEvent {
+    Cycles,
+    Instructions,
+    L1dMisses,
+    LlcMisses,
+    BranchMisses,
+    TaskClock,   // ns, only without hardware counters
+    Count
+};
+static constexpr int PERF_EVENT_COUNT = static_cast<int>(PerfEvent::Count);
+
+inline constexpr const char* PERF_EVENT_NAMES[PERF_EVENT_COUNT] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses", "task_ns"
+};
+
+extern Kernel g_perf_kernel;
+
+void PerfEnter(Kernel k);
+void PerfLeave(Kernel prev);
+
+// Charges the enclosed code to kernel k; a branch when not counting.
+// Main thread only, like PhaseScope.
+class KernelScope {
+public:
+    explicit KernelScope(Kernel k) : prev(g_perf_kernel) { if (g_perf_counting) PerfEnter(k); }
+    ~KernelScope() { if (g_perf_counting) PerfLeave(prev); }
+    KernelScope(const KernelScope&) = delete;
+    KernelScope& operator=(const KernelScope&) = delete;
+
+private:
+    Kernel prev;
+};
+
+// Open and start the counters of the calling thread. Rank 0 warns if
+// hardware counters or all counters are unavailable.
+void StartPerfCounters(int world_rank);
+
+// Stop counting and print the counts of each phase and kernel summed over
+// all ranks, per rank for the kernels, and as one JSON line ([PERF][JSON]).
+// Collective over MPI_COMM_WORLD; no-op unless StartPerfCounters ran.
+void ReportPerfCounters(int world_rank);
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// ----------------- Parallel PNG writer -----------------
+// Filters and deflates bands of rows on separate threads. Each band is a
+// self-contained deflate segment (its own LZ77 window) ended by a sync
+// flush, so the segments concatenate into one valid zlib stream; every
+// band is emitted as its own IDAT chunk.
+//
+// rgba: row-major, tightly packed 8-bit RGBA. threads <= 0 uses all
+// hardware threads. Returns false if the file cannot be written.
+bool WritePngParallel(const char* fname, const uint8_t* rgba,
+                      int width, int height, int threads = 0);
+
+// ----------------- Streaming PNG writer -----------------
+// Appends rows top to bottom as they become available. Every writeRows
+// call is filtered against the last row of the previous call and
+// deflated into its own IDAT chunk, so only one row is kept between
+// calls and the file is complete as soon as the last row arrives.
+struct PngStream {
+    PngStream() = default;
+    ~PngStream();
+    PngStream(const PngStream&) = delete;
+    PngStream& operator=(const PngStream&) = delete;
+
+    bool open(const char* fname, int width, int height);
+    bool writeRows(const uint8_t* rgba, int rows);   // rgba: rows x width RGBA8
+    bool close();                                    // false on any write error
+
+private:
+    FILE* f = nullptr;
+    int width = 0, height = 0, rows_written = 0;
+    uint32_t adler = 1;
+    bool ok = false;
+    std::vector<uint8_t> last_row;
+};
@@ -3,6 +3,15 @@
 #include <vector>
 #include "types.h"
 
+// Shading class of a material, decided once at load time.
+// Each class has its own compiled shading kernel (see lighting.cpp).
+enum class MaterialClass {
+    Diffuse,       // no specular, no transmission
+    Specular,      // specular highlights and mirror reflection, opaque
+    Transmissive,  // refraction (and reflection); the general path
+    Count
+};
+
 // ----------------- Material -----------------
 struct Material {
     Color ambient;   // ar, ag, ab
@@ -11,19 +20,26 @@ struct Material {
     double  ns;        // phong exponent
     Color trans;     // tr, tg, tb
     double  ior;       // index of refraction
+    MaterialClass shading = MaterialClass::Transmissive;
 };
 
+// Pick the cheapest shading class that produces the same result as the
+// general path for this material.
+MaterialClass classifyMaterial(const Material& m);
+
 struct HitInfo {
     double distance;
     Point3 point;
     Direction3 normal;
     Material* material;
+    int primitive = -1;   // index as in intersectPrimitive (spheres, then triangles)
 
     HitInfo() : distance(INFINITY) {}
     HitInfo(double distance, Point3 point, Direction3 normal, Material* material) : distance(distance), point(point), normal(normal), material(material) {}
 };
 
 struct Primitive {
+    virtual ~Primitive() = default;
     virtual Material* getMaterial() const = 0;
     virtual Direction3 get_normal_at_point(const Point3 &p) const = 0;
 };
@@ -49,4 +65,4 @@ struct Triangle : public Primitive {
 
     Material* getMaterial() const override;
     Direction3 get_normal_at_point(const Point3 &p) const override;
-};
\ No newline at end of file
+};
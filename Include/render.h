@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include "types.h"
+#include "ray.h"
+#include "scene.h"
+#include "lighting.h"
+#include "framebuffer.h"
+#include "aov.h"
+
+// ----------------- Row renderer -----------------
+// Camera setup shared by every band a rank traces, plus the scratch the
+// light-grid tile path reuses between bands.
+struct RenderContext {
+    const Scene& scene;
+    int width, height;
+    float halfW, halfH;
+    Point3 cam_origin;     // point on the view plane at distance d
+    Direction3 step_x;     // one-pixel step along x
+
+    // With a light grid, primary hits of a band of LIGHT_TILE rows are
+    // found first, then every LIGHT_TILE x LIGHT_TILE tile is shaded with
+    // the lights that can reach its hit points
+    bool tiled;
+    std::vector<Ray>     band_rays;
+    std::vector<HitInfo> band_hits;
+    std::vector<char>    band_found;
+    std::vector<const Light*> tile_lights;
+
+    RenderContext(const Scene& scene, int width, int height);
+};
+
+// Trace global rows [row0, row0 + nrows) into fb, starting at fb row fb_row0.
+// Enabled aovs buffers get the primary hits at the same rows.
+void RenderRows(RenderContext& ctx, int row0, int nrows, Framebuffer& fb, int fb_row0,
+                const AovBuffers* aovs = nullptr);
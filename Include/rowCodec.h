@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ----------------- Pixel run-length codec -----------------
+// Lossless, byte-oriented RLE over whole pixels, used to shrink rows sent
+// between ranks. Background-heavy renders are mostly long runs of one
+// pixel value. The stream is a sequence of tokens, each a LEB128 varint
+// h followed by pixels:
+//   h odd:  run of (h >> 1) + 1 copies of the one pixel that follows
+//   h even: (h >> 1) + 1 literal pixels
+// Never more than one header byte per 64 literal pixels over the input.
+
+// Append the encoding of n pixels of pixel_bytes each to out
+void EncodeRle(const uint8_t* pixels, size_t n, size_t pixel_bytes,
+               std::vector<uint8_t>& out);
+
+// Decode exactly n pixels into pixels; false if the input is malformed
+bool DecodeRle(const uint8_t* in, size_t in_bytes, uint8_t* pixels,
+               size_t n, size_t pixel_bytes);
@@ -4,6 +4,14 @@
 #include "types.h"
 #include "primitive.h"
 #include "lighting.h"
+#include "lightTree.h"
+#include "lightGrid.h"
+
+// How light_cutoff culls many point/spot lights
+enum class LightCulling {
+    Tree,   // light tree traversal per hit
+    Grid    // per-tile and per-grid-cell light lists
+};
 
 // ----------------- Scene -----------------
 struct Scene {
@@ -18,8 +26,14 @@ struct Scene {
     Color background;
     Color ambient_light;
     int max_depth;
+    double light_cutoff;   // skip lights whose unshadowed contribution is <= this
+    int light_samples;     // > 0: sample this many lights per hit from lightTree
+    LightCulling light_culling;
+    unsigned aovs;         // bit (1 << Aov) per auxiliary output to write
 
     std::vector<Light*> lights;
+    LightTree lightTree;   // built only for many-light scenes or light sampling
+    LightGrid lightGrid;   // built instead of lightTree with light_culling: grid
 
     // primitives
     std::vector<Sphere*>   spheres;
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include "primitive.h"
+
+// ----------------- Render statistics -----------------
+// Per-rank counters. Ranks trace single-threaded, so one global instance
+// per process is enough; ReportStats sums them over all ranks.
+// Only uint64_t members: the struct is reduced as a flat array.
+//
+// Counters are bumped through STAT_INC / STAT_ADD, which compile to
+// nothing with -DRT_NO_STATS (release-fast builds). primary_rays is
+// added once per RenderRows call and always counted; phase timing
+// derives Mrays/s from it.
+struct RenderStats {
+    // camera rays, one per pixel traced
+    uint64_t primary_rays = 0;
+
+    // rays spawned at specular / transmissive hits, and hits that would
+    // have spawned them but had no depth left
+    uint64_t reflection_rays = 0;
+    uint64_t refraction_rays = 0;
+    uint64_t depth_limited = 0;
+
+    // ray-primitive tests of closest-hit queries (camera, reflection and
+    // refraction rays) and of shadow queries (including cache probes)
+    uint64_t hit_sphere_tests = 0;
+    uint64_t hit_triangle_tests = 0;
+    uint64_t shadow_sphere_tests = 0;
+    uint64_t shadow_triangle_tests = 0;
+
+    // light tree nodes visited, and subtrees skipped by the cutoff bound
+    uint64_t light_tree_nodes = 0;
+    uint64_t light_tree_pruned = 0;
+
+    // hits shaded by each material-class kernel
+    uint64_t shade_hits[static_cast<int>(MaterialClass::Count)] = {};
+
+    // per-hit light evaluations (after light-tree culling or sampling)
+    uint64_t light_evals = 0;
+
+    // shadow rays traced, and light evaluations rejected before tracing one
+    uint64_t shadow_rays = 0;
+    uint64_t shadow_culled_cone = 0;
+    uint64_t shadow_culled_backface = 0;
+    uint64_t shadow_culled_cutoff = 0;
+
+    // shadow rays answered by a directional light's light-space grid
+    uint64_t shadow_grid_rays = 0;
+
+    // occluded shadow rays, and last-occluder cache probes / hits
+    uint64_t shadow_occluded = 0;
+    uint64_t shadow_cache_probes = 0;
+    uint64_t shadow_cache_hits = 0;
+};
+
+extern RenderStats g_stats;
+
+// Ray-primitive tests so far (zero with RT_NO_STATS)
+inline uint64_t IntersectionTests() {
+    return g_stats.hit_sphere_tests + g_stats.hit_triangle_tests
+         + g_stats.shadow_sphere_tests + g_stats.shadow_triangle_tests;
+}
+
+#ifdef RT_NO_STATS
+#define STAT_ADD(counter, n) ((void)0)
+#else
+#define STAT_ADD(counter, n) (g_stats.counter += (n))
+#endif
+#define STAT_INC(counter) STAT_ADD(counter, 1)
+
+// Sum counters over MPI_COMM_WORLD and print them on rank 0
+void ReportStats(int world_rank);
@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include <mpi.h>
+#include "render.h"
+
+// ----------------- Streamed rendering -----------------
+// Bands of STREAM_BAND_ROWS rows are dealt round-robin (band b to rank
+// b % size). Ranks send each band as soon as it is traced, with at most
+// STREAM_SEND_WINDOW sends in flight; rank 0 keeps one posted receive per
+// rank, renders its own bands while it waits and appends bands to the
+// ImageStream in image order. No rank holds more than a few bands.
+static constexpr int STREAM_BAND_ROWS   = 16;
+static constexpr int STREAM_SEND_WINDOW = 4;
+
+// Collective over comm; fname must satisfy ImageStreamSupported.
+// Returns false on rank 0 if the image could not be written.
+bool RenderStreamed(RenderContext& ctx, const std::string& fname, MPI_Comm comm);
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <mpi.h>
+#include "render.h"
+
+// ----------------- Tiled image (.tiles) -----------------
+// Output for films too large for a single-buffer encoder. Layout, all
+// little-endian:
+//
+//   TiledHeader
+//   TiledIndexEntry index[tiles_y * tiles_x]   row-major over tiles
+//   tile payloads
+//
+// A tile holds its rows (cropped at the right/bottom edge) of RGBA8
+// pixels, tightly packed. The index gives every tile's file offset and
+// size, so a viewer can read any tile without scanning the file.
+static constexpr int TILED_TILE_SIZE = 256;
+
+struct TiledHeader {
+    char     magic[8];       // "RTTILES1"
+    uint32_t width, height;
+    uint32_t tile_size;
+    uint32_t tiles_x, tiles_y;
+    uint32_t pixel_bytes;    // 4: RGBA8
+};
+
+struct TiledIndexEntry {
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+bool IsTiledFormat(const std::string& fname);
+
+// Ranks trace contiguous blocks of tile rows one tile row at a time and
+// write each one straight into the file with MPI-IO, so no rank holds
+// more than one tile row of pixels. With preview_size > 0 a box-filtered
+// preview whose longer side is at most preview_size (never downsampled
+// more than one tile per pixel) is built in the same pass, gathered and
+// written by rank 0 as <name>_preview.png. Collective over comm; returns
+// false on every rank if any write failed.
+bool RenderTiled(RenderContext& ctx, const std::string& fname,
+                 int preview_size, MPI_Comm comm);
@@ -0,0 +1,128 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <mpi.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// ----------------- Cycle counter -----------------
+// Cheap monotonic tick count for per-pixel cost: the time-stamp counter on
+// x86, nanoseconds elsewhere
+inline uint64_t CycleCount() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// ----------------- Phase timing -----------------
+// Wall time of each rank split into phases. Exactly one phase is current
+// at any time. A PhaseScope makes its phase current for its lifetime, then
+// returns to the enclosing one, so nested scopes charge time only to the
+// innermost phase. Everything outside a scope counts as Other.
+enum class Phase {
+    Other,
+    Parse,    // reading the scene file
+    Build,    // light preparation, light tree / grid
+    Trace,    // RenderRows
+    Wait,     // blocked on other ranks: barriers, waits on sends/receives
+    Gather,   // encoding, posting and storing gathered rows
+    Write,    // image encode and file output
+    Count
+};
+static constexpr int PHASE_COUNT = static_cast<int>(Phase::Count);
+
+inline constexpr const char* PHASE_NAMES[PHASE_COUNT] = {
+    "other", "parse", "build", "trace", "wait", "gather", "write"
+};
+
+// With --perf, hardware counters (perfCounters.h) are read at every switch
+extern bool g_perf_counting;
+void PerfSample();
+
+struct PhaseTiming {
+    double ms[PHASE_COUNT] = {};
+    Phase current = Phase::Other;
+    double since = 0.0;
+
+    void switchTo(Phase p) {
+        if (g_perf_counting) PerfSample();
+        double now = MPI_Wtime();
+        ms[static_cast<int>(current)] += (now - since) * 1000.0;
+        current = p;
+        since = now;
+    }
+};
+
+extern PhaseTiming g_timing;
+
+// ----------------- Timeline trace -----------------
+// With --trace, spans are recorded per thread and written at the end as
+// Chrome Trace Event JSON (chrome://tracing, ui.perfetto.dev): one process
+// per rank, one track per thread. Clocks are aligned to rank 0 when the
+// trace starts, so spans of different ranks line up.
+extern bool g_tracing;
+
+inline double TraceClock() {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// name and category must be string literals; row < 0 means none
+void RecordSpan(const char* name, const char* category, double start, double end, int row);
+
+// Records one span on the calling thread; any thread may use it
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* category, int row = -1)
+        : name(name), category(category), row(row), start(g_tracing ? TraceClock() : 0.0) {}
+    ~TraceSpan() { if (g_tracing) RecordSpan(name, category, start, TraceClock(), row); }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    const char* category;
+    int row;
+    double start;
+};
+
+// Main thread only: charges its phase and records a span named after the
+// phase unless given a name (a string literal). row tags rows in the trace.
+class PhaseScope {
+public:
+    explicit PhaseScope(Phase p, const char* name = nullptr, int row = -1)
+        : prev(g_timing.current),
+          span(name ? name : PHASE_NAMES[static_cast<int>(p)], PHASE_NAMES[static_cast<int>(p)], row) {
+        g_timing.switchTo(p);
+    }
+    ~PhaseScope() { g_timing.switchTo(prev); }
+    PhaseScope(const PhaseScope&) = delete;
+    PhaseScope& operator=(const PhaseScope&) = delete;
+
+private:
+    Phase prev;
+    TraceSpan span;
+};
+
+// Enable span recording and measure this rank's clock offset to rank 0.
+// Collective over MPI_COMM_WORLD.
+void StartTrace();
+
+// Gather every rank's spans and write them on rank 0 as one Chrome trace
+// file. Collective over MPI_COMM_WORLD; no-op unless StartTrace ran.
+bool WriteTrace(const std::string& fname, int world_rank);
+
+// Start the clock (charging Other); call once after MPI_Init
+void StartPhaseTiming();
+
+// Collect every rank's phase times on rank 0 and print min/mean/max per
+// phase, the trace imbalance, ray throughput and a one-line JSON summary
+// ([TIMING][JSON]) with the per-rank values. Collective over MPI_COMM_WORLD.
+void ReportPhaseTiming(int world_rank);
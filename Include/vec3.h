@@ -19,17 +19,17 @@ struct vec3{
         return vec3(-x, -y, -z);
     }
   //Clamp each component (used to clamp pixel colors)
-  vec3 clampTo1(){
+  vec3 clampTo1() const {
     return vec3(fmin(x,1),fmin(y,1),fmin(z,1));
   }
 
   //Compute vector length (you may also want length squared)
-  double length(){
+  double length() const {
     return sqrt(x*x+y*y+z*z);
   }
 
   //Create a unit-length vector
-  vec3 normalized(){
+  vec3 normalized() const {
     double len = sqrt(x*x+y*y+z*z);
     return vec3(x/len,y/len,z/len);
   }
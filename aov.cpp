@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "Include/aov.h"
+#include "Include/pngWriter.h"
+
+const char* AovName(Aov a) {
+    static const char* names[AOV_COUNT] = {
+        "depth", "normal", "albedo", "primitive", "cycles", "tests"
+    };
+    return names[static_cast<int>(a)];
+}
+
+PixelFormat AovFormat(Aov a) {
+    return a == Aov::Normal || a == Aov::Albedo ? PixelFormat::RGB32F : PixelFormat::R32F;
+}
+
+bool IsCostAov(Aov a) {
+    return a == Aov::Cycles || a == Aov::Tests;
+}
+
+std::string AovFileName(const std::string& imgName, Aov a, const char* ext) {
+    size_t dot = imgName.find_last_of('.');
+    size_t slash = imgName.find_last_of('/');
+    std::string stem = dot != std::string::npos && (slash == std::string::npos || dot > slash)
+                     ? imgName.substr(0, dot) : imgName;
+    return stem + "_" + AovName(a) + ext;
+}
+
+void AovBuffers::store(int x, int y, const HitInfo* hit) const {
+    if (Framebuffer* f = fb[static_cast<int>(Aov::Depth)]) {
+        f->setPixel(x, y, Color(hit ? hit->distance : INFINITY, 0, 0));
+    }
+    if (Framebuffer* f = fb[static_cast<int>(Aov::Normal)]) {
+        f->setPixel(x, y, hit ? Color(hit->normal.x, hit->normal.y, hit->normal.z) : Color(0, 0, 0));
+    }
+    if (Framebuffer* f = fb[static_cast<int>(Aov::Albedo)]) {
+        f->setPixel(x, y, hit ? hit->material->diffuse : Color(0, 0, 0));
+    }
+    if (Framebuffer* f = fb[static_cast<int>(Aov::Primitive)]) {
+        f->setPixel(x, y, Color(hit ? hit->primitive : -1, 0, 0));
+    }
+}
+
+void AovBuffers::storeCost(int x, int y, uint64_t cycles, uint64_t tests, bool add) const {
+    const uint64_t cost[2] = { cycles, tests };
+    const Aov aovs[2] = { Aov::Cycles, Aov::Tests };
+    for (int k = 0; k < 2; ++k) {
+        Framebuffer* f = fb[static_cast<int>(aovs[k])];
+        if (!f) continue;
+        float& px = reinterpret_cast<float*>(f->row(y))[x];
+        px = (add ? px : 0.0f) + static_cast<float>(cost[k]);
+    }
+}
+
+bool WriteHeatmap(const Framebuffer& fb, const std::string& fname) {
+    const size_t n = static_cast<size_t>(fb.width) * fb.height;
+    const float* v = reinterpret_cast<const float*>(fb.data);
+
+    // 1st to 99th percentile, so a few interrupted pixels do not flatten
+    // the map and the cheapest pixels stay black
+    double lo = 1.0, hi = 1.0;
+    if (n > 0) {
+        std::vector<float> sorted(v, v + n);
+        size_t k = n / 100;
+        std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+        lo = std::max(1.0f, sorted[k]);
+        k = std::min(n - 1, n * 99 / 100);
+        std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+        hi = std::max(1.0f, sorted[k]);
+    }
+    double log_lo = std::log(lo);
+    double scale = hi > lo ? 1.0 / (std::log(hi) - log_lo) : 0.0;
+
+    // black, red, yellow, white
+    static const float stops[4][3] = { {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {1, 1, 1} };
+    std::vector<uint8_t> rgba(n * 4);
+    for (size_t i = 0; i < n; ++i) {
+        double x = std::max(1.0, static_cast<double>(v[i]));
+        double t = std::min(1.0, std::max(0.0, (std::log(x) - log_lo) * scale)) * 3.0;
+        int s = std::min(2, static_cast<int>(t));
+        double f = t - s;
+        for (int c = 0; c < 3; ++c) {
+            double y = stops[s][c] + (stops[s + 1][c] - stops[s][c]) * f;
+            rgba[4 * i + c] = static_cast<uint8_t>(y * 255.0 + 0.5);
+        }
+        rgba[4 * i + 3] = 255;
+    }
+    return WritePngParallel(fname.c_str(), rgba.data(), fb.width, fb.height);
+}
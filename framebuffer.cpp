@@ -0,0 +1,129 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "Include/framebuffer.h"
+#include "Include/imageStream.h"
+#include "Include/memoryReport.h"
+#include "Include/pngWriter.h"
+#include "Include/Image/stb_image_write.h"
+
+PixelFormat PixelFormatFor(const std::string& fname) {
+    // PFM and EXR keep the float radiance; every other encoder takes 8-bit pixels
+    size_t n = fname.size();
+    if (n >= 4 && (fname.compare(n - 4, 4, ".pfm") == 0 ||
+                   fname.compare(n - 4, 4, ".exr") == 0)) return PixelFormat::RGB32F;
+    return PixelFormat::RGBA8;
+}
+
+static std::string scratchDir;
+
+void SetFramebufferScratchDir(const std::string& dir) {
+    scratchDir = dir;
+}
+
+// Shared mapping of an unlinked temporary file; null on failure
+static uint8_t* mapScratch(size_t n) {
+    std::string dir = scratchDir;
+    if (dir.empty()) {
+        const char* tmp = std::getenv("TMPDIR");
+        dir = tmp && *tmp ? tmp : "/tmp";
+    }
+    std::string path = dir + "/raytracer_fb_XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+
+    int fd = mkstemp(name.data());
+    if (fd < 0) return nullptr;
+    unlink(name.data());   // space is released when the mapping goes away
+
+    void* p = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(n)) == 0) {
+        p = mmap(nullptr, n, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    return p == MAP_FAILED ? nullptr : static_cast<uint8_t*>(p);
+}
+
+Framebuffer::Framebuffer(int w, int h, PixelFormat format)
+    : width(w), height(h), format(format) {
+    size_t n = bytes();
+    if (n > FRAMEBUFFER_MMAP_BYTES) {
+        data = mapScratch(n);
+        mapped = data != nullptr;
+        if (!mapped) {
+            std::cerr << "Warning: cannot map a " << (n >> 20)
+                      << " MB framebuffer on disk, using memory" << std::endl;
+        }
+    }
+    if (!mapped) {
+        size_t padded = (n + FRAMEBUFFER_ALIGN - 1) / FRAMEBUFFER_ALIGN * FRAMEBUFFER_ALIGN;
+        data = static_cast<uint8_t*>(std::aligned_alloc(FRAMEBUFFER_ALIGN,
+                                                        padded ? padded : FRAMEBUFFER_ALIGN));
+    }
+    (mapped ? g_mapped_framebuffer_memory : g_framebuffer_memory).add(n);
+}
+
+Framebuffer::~Framebuffer() {
+    (mapped ? g_mapped_framebuffer_memory : g_framebuffer_memory).remove(bytes());
+    if (mapped) munmap(data, bytes());
+    else        std::free(data);
+}
+
+void Framebuffer::write(const char* fname) const {
+    int lastc = strlen(fname);
+
+    // ppm / pfm: a header, then rows in file order. A pfm row is exactly a
+    // float framebuffer row, so float images are dumped without conversion
+    if (IsRasterFormat(fname)) {
+        FILE* f = fopen(fname, "wb");
+        bool ok = f && fputs(RasterHeader(fname, format, width, height).c_str(), f) >= 0;
+        bool dump = format != PixelFormat::RGBA8;
+        size_t file_row_bytes = RasterRowBytes(fname, format, width);
+        std::vector<uint8_t> packed(dump ? 0 : file_row_bytes);
+        for (int k = 0; k < height && ok; ++k) {
+            const uint8_t* src = row(RasterFileRow(fname, k, height));
+            if (!dump) {
+                PackRasterRow(fname, format, src, width, packed.data());
+                src = packed.data();
+            }
+            ok = fwrite(src, 1, file_row_bytes, f) == file_row_bytes;
+        }
+        if (f) ok = fclose(f) == 0 && ok;
+        if (!ok) std::cerr << "Cannot write image file: " << fname << std::endl;
+        return;
+    }
+
+    // exr: float planes, one scanline chunk per row
+    if (format == PixelFormat::RGB32F && fname[lastc-1] == 'r') {
+        std::unique_ptr<ImageStream> out = OpenImageStream(fname, width, height);
+        if (!out || !out->writeRows(data, height) || !out->close()) {
+            std::cerr << "Cannot write image file: " << fname << std::endl;
+        }
+        return;
+    }
+
+    // LDR outputs are RGBA8, quantized by setPixel while shading, so the
+    // framebuffer is handed to the encoder as is
+    bool ok = false;
+    switch (fname[lastc-1]){
+      case 'g': //jpeg (or jpg) or png
+        if (fname[lastc-2] == 'p' || fname[lastc-2] == 'e') //jpeg or jpg
+            ok = stbi_write_jpg(fname, width, height, 4, data, 95) != 0;  //95% jpeg quality
+        else //png: bands filtered and deflated in parallel
+            ok = WritePngParallel(fname, data, width, height);
+        break;
+      case 'a': //tga (targa)
+        ok = stbi_write_tga(fname, width, height, 4, data) != 0;
+        break;
+      case 'p': //bmp
+      default:
+        ok = stbi_write_bmp(fname, width, height, 4, data) != 0;
+    }
+    if (!ok) std::cerr << "Cannot write image file: " << fname << std::endl;
+}
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "Include/gather.h"
+#include "Include/rowCodec.h"
+#include "Include/timing.h"
+
+static constexpr int GATHER_TAG = 2;   // + layer
+
+RowGather::RowGather(const std::vector<Framebuffer*>& layers, const std::vector<int>& counts,
+                     const std::vector<int>& displs, MPI_Comm comm, bool compress)
+    : layers(layers), counts(counts), displs(displs), comm(comm), compress(compress) {
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    if (rank != 0) {
+        for (Framebuffer* fb : layers) {
+            traffic.raw_bytes += static_cast<uint64_t>(counts[rank]) * fb->rowBytes();
+        }
+        return;
+    }
+
+    // Slots of a rank and layer are posted in chunk order, and MPI matches
+    // messages from one source and tag in send order
+    const int L = static_cast<int>(layers.size());
+    next_chunk.assign(static_cast<size_t>(size) * L, 0);
+    for (int r = 1; r < size; ++r) {
+        for (int l = 0; l < L; ++l) {
+            for (int w = 0; w < GATHER_RECV_WINDOW; ++w) {
+                slots.push_back({ r, l, -1, {} });
+                recvs.push_back(MPI_REQUEST_NULL);
+                postRecv(slots.size() - 1);
+            }
+        }
+    }
+}
+
+RowGather::~RowGather() {
+    if (pending > 0 || !sends.empty()) finish();
+}
+
+int RowGather::chunkCount(int r) const {
+    return (counts[r] + GATHER_CHUNK_ROWS - 1) / GATHER_CHUNK_ROWS;
+}
+
+void RowGather::postRecv(size_t s) {
+    Slot& slot = slots[s];
+    int& next = next_chunk[static_cast<size_t>(slot.source) * layers.size() + slot.layer];
+    if (next >= chunkCount(slot.source)) return;
+    slot.chunk = next++;
+
+    Framebuffer& fb = *layers[slot.layer];
+    int row  = slot.chunk * GATHER_CHUNK_ROWS;
+    int rows = std::min(GATHER_CHUNK_ROWS, counts[slot.source] - row);
+    int bytes = static_cast<int>(rows * fb.rowBytes());
+
+    // Raw chunks land in place; encoded ones are never larger than raw
+    uint8_t* target = fb.row(displs[slot.source] + row);
+    if (compress) {
+        slot.buffer.resize(bytes);
+        target = slot.buffer.data();
+    }
+    MPI_Irecv(target, bytes, MPI_BYTE, slot.source, GATHER_TAG + slot.layer, comm, &recvs[s]);
+    ++pending;
+}
+
+void RowGather::store(size_t s, const MPI_Status& status) {
+    Slot& slot = slots[s];
+    PhaseScope phase(Phase::Gather, "recv", displs[slot.source] + slot.chunk * GATHER_CHUNK_ROWS);
+    --pending;
+    if (compress) {
+        Framebuffer& fb = *layers[slot.layer];
+        int row  = slot.chunk * GATHER_CHUNK_ROWS;
+        int rows = std::min(GATHER_CHUNK_ROWS, counts[slot.source] - row);
+        size_t raw = rows * fb.rowBytes();
+        uint8_t* dst = fb.row(displs[slot.source] + row);
+
+        int bytes = 0;
+        MPI_Get_count(&status, MPI_BYTE, &bytes);
+        if (static_cast<size_t>(bytes) == raw) {
+            memcpy(dst, slot.buffer.data(), raw);
+        } else if (!DecodeRle(slot.buffer.data(), bytes, dst,
+                              static_cast<size_t>(rows) * fb.width, fb.pixelBytes())) {
+            std::cerr << "Error: corrupt rows received from rank " << slot.source << std::endl;
+            ok = false;
+        }
+    }
+    postRecv(s);
+}
+
+void RowGather::drain(bool block) {
+    std::vector<int> done(recvs.size());
+    std::vector<MPI_Status> statuses(recvs.size());
+    while (pending > 0) {
+        int n = 0;
+        if (block) {
+            PhaseScope wait(Phase::Wait, "wait recv");
+            MPI_Waitsome(static_cast<int>(recvs.size()), recvs.data(), &n, done.data(), statuses.data());
+        } else {
+            MPI_Testsome(static_cast<int>(recvs.size()), recvs.data(), &n, done.data(), statuses.data());
+            if (n == 0) return;
+        }
+        for (int i = 0; i < n; ++i) store(done[i], statuses[i]);
+    }
+}
+
+void RowGather::send(int row, int n) {
+    PhaseScope phase(Phase::Gather, rank == 0 ? "poll" : "send", row);
+    if (rank == 0) {
+        drain(false);
+        return;
+    }
+
+    for (size_t l = 0; l < layers.size(); ++l) {
+        const Framebuffer& fb = *layers[l];
+        const uint8_t* rows = fb.row(row);
+        size_t raw = n * fb.rowBytes();
+
+        const uint8_t* data = rows;
+        size_t bytes = raw;
+        if (compress) {
+            std::vector<uint8_t> chunk;
+            EncodeRle(rows, static_cast<size_t>(n) * fb.width, fb.pixelBytes(), chunk);
+            if (chunk.size() < raw) {
+                encoded.push_back(std::move(chunk));
+                data = encoded.back().data();
+                bytes = encoded.back().size();
+            }
+        }
+
+        sends.push_back(MPI_REQUEST_NULL);
+        MPI_Isend(data, static_cast<int>(bytes), MPI_BYTE, 0, GATHER_TAG + static_cast<int>(l),
+                  comm, &sends.back());
+        traffic.sent_bytes += bytes;
+    }
+}
+
+bool RowGather::finish() {
+    if (rank == 0) {
+        drain(true);
+    } else {
+        PhaseScope wait(Phase::Wait, "wait send");
+        MPI_Waitall(static_cast<int>(sends.size()), sends.data(), MPI_STATUSES_IGNORE);
+        sends.clear();
+        encoded.clear();
+    }
+    return ok;
+}
+
+// ----------------- Two-level gather -----------------
+
+NodeGather::NodeGather(MPI_Comm comm, bool flat) : flat(flat) {
+    int rank = 0, size = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    if (flat) {
+        MPI_Comm_dup(comm, &ordered);
+        MPI_Comm_dup(comm, &node);
+        ordered_rank = rank;
+        ordered_size = node_size = size;
+        return;
+    }
+
+    // Lowest rank on each node leads it. Sorting by (leader, rank) keeps
+    // rank 0 first and each node's ranks together.
+    MPI_Comm shared;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &shared);
+    int leader = rank;
+    MPI_Bcast(&leader, 1, MPI_INT, 0, shared);
+    MPI_Comm_free(&shared);
+
+    std::vector<int> leader_of(size);
+    MPI_Allgather(&leader, 1, MPI_INT, leader_of.data(), 1, MPI_INT, comm);
+    int position = 0;
+    node_count = 0;
+    for (int r = 0; r < size; ++r) {
+        if (leader_of[r] < leader || (leader_of[r] == leader && r < rank)) ++position;
+        if (leader_of[r] == r) ++node_count;
+    }
+    MPI_Comm_split(comm, 0, position, &ordered);
+    MPI_Comm_rank(ordered, &ordered_rank);
+    MPI_Comm_size(ordered, &ordered_size);
+
+    MPI_Comm_split_type(ordered, MPI_COMM_TYPE_SHARED, ordered_rank, MPI_INFO_NULL, &node);
+    int node_rank = 0;
+    MPI_Comm_rank(node, &node_rank);
+    MPI_Comm_size(node, &node_size);
+    node_first = ordered_rank - node_rank;
+
+    MPI_Comm_split(ordered, node_rank == 0 ? 0 : MPI_UNDEFINED, ordered_rank, &leaders);
+}
+
+NodeGather::~NodeGather() {
+    local.reset();
+    for (MPI_Comm* c : { &ordered, &node, &leaders }) {
+        if (*c != MPI_COMM_NULL) MPI_Comm_free(c);
+    }
+}
+
+int NodeGather::bufferRows(const std::vector<int>& counts) const {
+    if (ordered_rank == 0) {
+        int rows = 0;
+        for (int c : counts) rows += c;
+        return rows;
+    }
+    if (ordered_rank != node_first) return counts[ordered_rank];
+
+    int rows = 0;
+    for (int r = node_first; r < node_first + node_size; ++r) rows += counts[r];
+    return rows;
+}
+
+void NodeGather::start(const std::vector<Framebuffer*>& layers, const std::vector<int>& counts,
+                       const std::vector<int>& displs, bool compress, bool compress_node) {
+    this->layers = layers;
+    this->counts = counts;
+    this->displs = displs;
+    this->compress = compress;
+
+    // Rows relative to the node's block, which starts at its leader's rows
+    std::vector<int> node_counts(counts.begin() + node_first,
+                                 counts.begin() + node_first + node_size);
+    std::vector<int> node_displs(node_size);
+    for (int i = 0; i < node_size; ++i) {
+        node_displs[i] = displs[node_first + i] - displs[node_first];
+    }
+
+    // Inside a node raw rows are usually cheaper to copy than to encode
+    bool compress_local = compress && (flat || compress_node);
+    local.reset(new RowGather(layers, node_counts, node_displs, node, compress_local));
+}
+
+bool NodeGather::finish() {
+    bool ok = local->finish();
+    if (flat) {
+        traffic = local->traffic;
+        return ok;
+    }
+    node_traffic = local->traffic;
+    if (leaders == MPI_COMM_NULL) return ok;
+
+    int n_leaders = 1;
+    MPI_Comm_size(leaders, &n_leaders);
+
+    // Node blocks, per leader
+    int block[2] = { displs[node_first], 0 };
+    for (int r = node_first; r < node_first + node_size; ++r) block[1] += counts[r];
+    std::vector<int> blocks(2 * n_leaders);
+    MPI_Allgather(block, 2, MPI_INT, blocks.data(), 2, MPI_INT, leaders);
+
+    std::vector<int> leader_counts(n_leaders), leader_displs(n_leaders);
+    for (int l = 0; l < n_leaders; ++l) {
+        leader_displs[l] = blocks[2 * l];
+        leader_counts[l] = blocks[2 * l + 1];
+    }
+
+    RowGather global(layers, leader_counts, leader_displs, leaders, compress);
+    for (int r = 0; r < block[1]; r += GATHER_CHUNK_ROWS) {
+        global.send(r, std::min(GATHER_CHUNK_ROWS, block[1] - r));
+    }
+    ok = global.finish() && ok;
+    traffic = global.traffic;
+    return ok;
+}
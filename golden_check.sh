@@ -0,0 +1,202 @@
+#!/bin/bash
+# Golden-image regression and performance gate: renders each scene that has
+# a reference image in test_results/, compares it with image_diff and
+# checks the median render time against a stored baseline.
+#
+# usage: ./golden_check.sh [options] [scene ...]
+#   -b <binary>   renderer (default ./raytracer_mpi)
+#   -d <binary>   image comparer (default ./image_diff)
+#   -n <ranks>    ranks per render (default 4)
+#   -t <trials>   timed renders per scene, median is kept (default 3)
+#   -p <dB>       minimum PSNR (default 40)
+#   -e <n>        maximum error of any channel, 0..255 (default 2)
+#   -s <percent>  allowed slowdown over the baseline (default 15)
+#   -T <file>     per-scene image limits (default test_results/golden_tolerance.txt)
+#   -B <file>     timing baseline (default test_results/perf_baseline.csv)
+#   -u            store this run's times in the baseline instead of checking
+#   -o <dir>      output directory (default golden_results/<timestamp>)
+#   -m "<args>"   extra mpirun options, e.g. "--oversubscribe"
+# Without scenes, every Tests/*/*.txt is run. A scene's golden image is the
+# file in test_results/ named like its output_image; scenes without one
+# are skipped. Lines of the -T file ("<scene> <min psnr> <max error>")
+# replace -p and -e for one scene. Slowdowns under 10 ms are ignored as
+# noise. Exit status is 1 if any image or time check fails.
+set -u
+
+BIN=./raytracer_mpi
+DIFF=./image_diff
+NP=4
+TRIALS=3
+MIN_PSNR=40
+MAX_ERROR=2
+SLOWDOWN=15
+TOLERANCE=test_results/golden_tolerance.txt
+BASELINE=test_results/perf_baseline.csv
+UPDATE=0
+OUT=""
+MPI_ARGS=""
+
+while getopts "b:d:n:t:p:e:s:T:B:uo:m:h" opt; do
+    case $opt in
+        b) BIN=$OPTARG ;;
+        d) DIFF=$OPTARG ;;
+        n) NP=$OPTARG ;;
+        t) TRIALS=$OPTARG ;;
+        p) MIN_PSNR=$OPTARG ;;
+        e) MAX_ERROR=$OPTARG ;;
+        s) SLOWDOWN=$OPTARG ;;
+        T) TOLERANCE=$OPTARG ;;
+        B) BASELINE=$OPTARG ;;
+        u) UPDATE=1 ;;
+        o) OUT=$OPTARG ;;
+        m) MPI_ARGS=$OPTARG ;;
+        *) sed -n '2,25p' "$0" | sed 's/^# \{0,1\}//'; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+for tool in "$BIN" "$DIFF"; do
+    if [ ! -f "$tool" ] || [ ! -x "$tool" ]; then
+        echo "Error: $tool not found; build it first (README steps 5 and 21)" >&2
+        exit 1
+    fi
+done
+BIN=$(cd "$(dirname "$BIN")" && pwd)/$(basename "$BIN")
+DIFF=$(cd "$(dirname "$DIFF")" && pwd)/$(basename "$DIFF")
+
+# -------- scenes and their golden images --------
+if [ $# -gt 0 ]; then
+    REQUESTED=("$@")
+else
+    REQUESTED=(Tests/*/*.txt)
+fi
+SCENES=()
+GOLDEN=()
+for s in "${REQUESTED[@]}"; do
+    if [ ! -f "$s" ]; then
+        echo "Warning: scene $s not found, skipped" >&2
+        continue
+    fi
+    image=$(awk '$1 == "output_image:" {print $2}' "$s" | tr -d '"\r' | tail -1)
+    image=$(basename "${image:-raytraced.bmp}")
+    golden=$(find test_results -name "$image" -type f | sort | head -1)
+    if [ -z "$golden" ]; then
+        echo "Note: no golden image for $s ($image), skipped" >&2
+        continue
+    fi
+    SCENES+=("$s")
+    GOLDEN+=("$(pwd)/$golden")
+done
+if [ ${#SCENES[@]} -eq 0 ]; then
+    echo "Error: no scenes with a golden image" >&2
+    exit 1
+fi
+
+[ -z "$OUT" ] && OUT="golden_results/$(date +%Y%m%d-%H%M%S)"
+mkdir -p "$OUT/logs" "$OUT/images"
+OUT=$(cd "$OUT" && pwd)
+RESULTS="$OUT/results.csv"
+HOST=$(hostname)
+
+if [ $UPDATE -eq 0 ] && [ ! -f "$BASELINE" ]; then
+    echo "Note: no timing baseline $BASELINE; times are not checked (create one with -u)"
+fi
+echo "Golden check: ${#SCENES[@]} scene(s), np=$NP, $TRIALS trial(s), PSNR >= $MIN_PSNR dB," \
+     "max error <= $MAX_ERROR, slowdown <= $SLOWDOWN%"
+echo ""
+
+# -------- render, compare, time --------
+echo "scene,np,image,psnr,max_error,min_psnr,max_error_limit,total_ms,baseline_ms,change_pct,status" > "$RESULTS"
+failures=0
+printf "%-44s %8s %6s %12s %12s %8s  %s\n" "scene" "psnr" "max" "total ms" "baseline" "change" "result"
+for k in "${!SCENES[@]}"; do
+    scene=${SCENES[$k]}
+    golden=${GOLDEN[$k]}
+    name=$(echo "${scene%.txt}" | tr '/' '_')
+    scene_path=$(cd "$(dirname "$scene")" && pwd)/$(basename "$scene")
+    image=$(basename "$golden")
+
+    # Each scene renders into its own directory so images cannot mix
+    work="$OUT/images/$name"
+    mkdir -p "$work"
+    times=""
+    rendered=1
+    for trial in $(seq 1 "$TRIALS"); do
+        log="$OUT/logs/${name}_t${trial}.log"
+        (cd "$work" && mpirun $MPI_ARGS -np "$NP" "$BIN" "$scene_path") > "$log" 2>&1
+        code=$?
+        total=$(awk '/^\[TIMING\]\[MPI\] total:/ {print $3}' "$log")
+        if [ $code -ne 0 ] || [ -z "$total" ]; then
+            rendered=0
+            break
+        fi
+        times="$times $total"
+    done
+    if [ $rendered -eq 0 ]; then
+        printf "%-44s %8s %6s %12s %12s %8s  %s\n" "$scene" "-" "-" "-" "-" "-" "FAIL (render, see $log)"
+        echo "$scene,$NP,$image,,,,,,,,render failed" >> "$RESULTS"
+        failures=$((failures + 1))
+        continue
+    fi
+    median=$(echo $times | tr ' ' '\n' | sort -g | awk '{v[NR] = $1} END {print NR % 2 ? v[(NR + 1) / 2] : (v[NR / 2] + v[NR / 2 + 1]) / 2}')
+
+    # Image limits: the scene's line in the tolerance file, else -p and -e
+    limits=""
+    [ -f "$TOLERANCE" ] && limits=$(awk -v s="$scene" '$1 == s {print $2, $3}' "$TOLERANCE" | tail -1)
+    read -r min_psnr max_error <<< "${limits:-$MIN_PSNR $MAX_ERROR}"
+    diff_out=$("$DIFF" "$work/$image" "$golden" --min-psnr "$min_psnr" --max-error "$max_error")
+    diff_code=$?
+    psnr=$(echo "$diff_out" | sed -n 's/.*psnr=\([^ ]*\).*/\1/p')
+    maxerr=$(echo "$diff_out" | sed -n 's/.*max=\([^ ]*\).*/\1/p')
+    status=ok
+    if [ $diff_code -ne 0 ]; then
+        status="image mismatch"
+        [ -z "$psnr" ] && status="image unreadable: ${diff_out#\[DIFF\] }"
+    fi
+
+    # Baseline of this scene at this rank count. Scenes of a few ms vary by
+    # more than the limit between runs, so differences under 10 ms pass.
+    base=""
+    change=""
+    if [ $UPDATE -eq 0 ] && [ -f "$BASELINE" ]; then
+        base=$(awk -F, -v s="$scene" -v np="$NP" '$1 == s && $2 == np {print $3}' "$BASELINE" | tail -1)
+    fi
+    if [ -n "$base" ]; then
+        change=$(awk -v t="$median" -v b="$base" 'BEGIN {printf "%.1f", (t - b) / b * 100}')
+        if awk -v c="$change" -v limit="$SLOWDOWN" 'BEGIN {exit !(c > limit)}' &&
+           awk -v t="$median" -v b="$base" 'BEGIN {exit !(t - b >= 10)}'; then
+            [ "$status" = ok ] && status="slowdown" || status="$status; slowdown"
+        fi
+    fi
+
+    [ "$status" = ok ] || failures=$((failures + 1))
+    printf "%-44s %8s %6s %12.3f %12s %8s  %s\n" "$scene" "${psnr:--}" "${maxerr:--}" "$median" \
+           "${base:--}" "${change:+$change%}" "$status"
+    echo "$scene,$NP,$image,$psnr,$maxerr,$min_psnr,$max_error,$median,$base,$change,$status" >> "$RESULTS"
+done
+
+# -------- baseline update --------
+# Replace this run's scenes at this rank count, keep every other line
+if [ $UPDATE -eq 1 ]; then
+    tmp=$(mktemp)
+    echo "scene,np,total_ms,host" > "$tmp"
+    if [ -f "$BASELINE" ]; then
+        awk -F, -v np="$NP" 'NR == FNR {if (FNR > 1) ran[$1] = 1; next}
+                             FNR > 1 && !($1 in ran && $2 == np)' "$RESULTS" "$BASELINE" >> "$tmp"
+    fi
+    awk -F, -v host="$HOST" 'NR > 1 && $8 != "" {print $1 "," $2 "," $8 "," host}' "$RESULTS" >> "$tmp"
+    mv "$tmp" "$BASELINE"
+    echo ""
+    echo "Baseline $BASELINE updated"
+elif [ -f "$BASELINE" ] && ! awk -F, -v host="$HOST" 'NR > 1 && $4 != host {exit 1}' "$BASELINE"; then
+    echo ""
+    echo "Note: part of the baseline was measured on another host"
+fi
+
+echo ""
+echo "Results in $RESULTS"
+if [ $failures -gt 0 ]; then
+    echo "$failures scene(s) FAILED"
+    exit 1
+fi
+echo "All scenes passed"
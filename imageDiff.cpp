@@ -0,0 +1,75 @@
+// Compares a rendered image with a golden one: PSNR over the RGB channels,
+// the largest channel error and the number of pixels that differ. Used by
+// golden_check.sh; see the README for its compile command.
+//
+//   image_diff <image> <golden> [--min-psnr dB] [--max-error n]
+//
+// Exit status: 0 within both limits, 1 outside them, 2 if an image cannot
+// be read or the sizes differ.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "Include/Image/stb_image.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::printf("Usage: image_diff <image> <golden> [--min-psnr dB] [--max-error n]\n");
+        return 2;
+    }
+
+    double min_psnr = 40.0;
+    int max_error = 2;
+    for (int a = 3; a < argc; ++a) {
+        std::string opt = argv[a];
+        if (opt == "--min-psnr" && a + 1 < argc) {
+            min_psnr = std::atof(argv[++a]);
+        } else if (opt == "--max-error" && a + 1 < argc) {
+            max_error = std::atoi(argv[++a]);
+        } else {
+            std::fprintf(stderr, "Warning: unknown option %s\n", opt.c_str());
+        }
+    }
+
+    int w = 0, h = 0, n = 0, gw = 0, gh = 0, gn = 0;
+    unsigned char* img    = stbi_load(argv[1], &w, &h, &n, 3);
+    unsigned char* golden = stbi_load(argv[2], &gw, &gh, &gn, 3);
+    if (!img || !golden) {
+        std::printf("[DIFF] cannot read %s\n", img ? argv[2] : argv[1]);
+        return 2;
+    }
+    if (w != gw || h != gh) {
+        std::printf("[DIFF] size %dx%d, golden %dx%d\n", w, h, gw, gh);
+        return 2;
+    }
+
+    // Squared error, worst channel, and pixels with any channel off
+    size_t pixels = static_cast<size_t>(w) * h;
+    double sq = 0.0;
+    int worst = 0;
+    size_t differing = 0;
+    for (size_t p = 0; p < pixels; ++p) {
+        bool differs = false;
+        for (int c = 0; c < 3; ++c) {
+            int d = std::abs(img[3 * p + c] - golden[3 * p + c]);
+            sq += double(d) * d;
+            if (d > worst) worst = d;
+            differs = differs || d;
+        }
+        if (differs) ++differing;
+    }
+    stbi_image_free(img);
+    stbi_image_free(golden);
+
+    // Identical images have infinite PSNR; report it as 99 dB
+    double mse = sq / (3.0 * pixels);
+    double psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+    bool ok = psnr >= min_psnr && worst <= max_error;
+
+    std::printf("[DIFF] psnr=%.2f max=%d differing=%zu/%zu %s\n", psnr, worst, differing, pixels,
+                ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
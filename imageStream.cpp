@@ -0,0 +1,229 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "Include/imageStream.h"
+#include "Include/pngWriter.h"
+
+static bool hasExtension(const std::string& fname, const char* ext) {
+    size_t n = strlen(ext);
+    return fname.size() >= n && fname.compare(fname.size() - n, n, ext) == 0;
+}
+
+// ----------------- Raw rasters (ppm, pfm) -----------------
+
+bool IsRasterFormat(const std::string& fname) {
+    return hasExtension(fname, ".ppm") || hasExtension(fname, ".pfm");
+}
+
+std::string RasterHeader(const std::string& fname, PixelFormat format, int width, int height) {
+    char header[64];
+    if (hasExtension(fname, ".pfm")) {
+        snprintf(header, sizeof(header), "%s\n%d %d\n-1.0\n",
+                 format == PixelFormat::R32F ? "Pf" : "PF", width, height);
+    } else {
+        snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+    }
+    return header;
+}
+
+size_t RasterRowBytes(const std::string& fname, PixelFormat format, int width) {
+    return static_cast<size_t>(width) * (hasExtension(fname, ".pfm") ? PixelBytes(format) : 3);
+}
+
+int RasterFileRow(const std::string& fname, int y, int height) {
+    return hasExtension(fname, ".pfm") ? height - 1 - y : y;
+}
+
+void PackRasterRow(const std::string& fname, PixelFormat format,
+                   const uint8_t* row, int width, uint8_t* out) {
+    if (hasExtension(fname, ".pfm")) {
+        // float framebuffer rows are already little-endian pfm rows
+        memcpy(out, row, RasterRowBytes(fname, format, width));
+        return;
+    }
+    for (int i = 0; i < width; ++i) {
+        out[3 * i + 0] = row[4 * i + 0];
+        out[3 * i + 1] = row[4 * i + 1];
+        out[3 * i + 2] = row[4 * i + 2];
+    }
+}
+
+// Each row goes straight to its final offset (pfm rows are bottom up)
+class RasterStream : public ImageStream {
+public:
+    RasterStream(FILE* f, const std::string& fname, int width, int height)
+        : f(f), fname(fname), format(PixelFormatFor(fname)), width(width), height(height),
+          header(RasterHeader(fname, format, width, height).size()),
+          packed(RasterRowBytes(fname, format, width)) {
+        ok = fputs(RasterHeader(fname, format, width, height).c_str(), f) >= 0;
+    }
+    ~RasterStream() override { if (f) fclose(f); }
+
+    bool writeRows(const uint8_t* rows, int n) override {
+        size_t fb_row_bytes = static_cast<size_t>(width) * PixelBytes(format);
+        for (int y = 0; y < n && ok; ++y, ++next_row) {
+            PackRasterRow(fname, format, rows + fb_row_bytes * y, width, packed.data());
+            long offset = header + static_cast<long>(packed.size())
+                                 * RasterFileRow(fname, next_row, height);
+            ok = fseek(f, offset, SEEK_SET) == 0
+              && fwrite(packed.data(), 1, packed.size(), f) == packed.size();
+        }
+        return ok;
+    }
+
+    bool close() override {
+        ok = fclose(f) == 0 && ok && next_row == height;
+        f = nullptr;
+        return ok;
+    }
+
+private:
+    FILE* f;
+    std::string fname;
+    PixelFormat format;
+    int width, height;
+    int next_row = 0;
+    long header;
+    std::vector<uint8_t> packed;
+    bool ok;
+};
+
+// ----------------- OpenEXR (scanline, FLOAT, uncompressed) -----------------
+// Single-part scanline file with B, G, R FLOAT channels (EXR sorts channel
+// names), NO_COMPRESSION and one scanline per chunk, so every chunk has the
+// same size and the offset table is known before any row is written.
+
+static void putBytes(std::vector<uint8_t>& v, const void* p, size_t n) {
+    const uint8_t* b = static_cast<const uint8_t*>(p);
+    v.insert(v.end(), b, b + n);
+}
+
+static void putI32(std::vector<uint8_t>& v, int32_t x) { putBytes(v, &x, 4); }
+
+static void putAttribute(std::vector<uint8_t>& v, const char* name, const char* type,
+                         const std::vector<uint8_t>& value) {
+    putBytes(v, name, strlen(name) + 1);
+    putBytes(v, type, strlen(type) + 1);
+    putI32(v, static_cast<int32_t>(value.size()));
+    putBytes(v, value.data(), value.size());
+}
+
+static std::vector<uint8_t> exrHeader(int width, int height) {
+    std::vector<uint8_t> h;
+    const uint8_t magic[4] = { 0x76, 0x2f, 0x31, 0x01 };
+    putBytes(h, magic, 4);
+    putI32(h, 2);   // version 2, single-part scanline
+
+    std::vector<uint8_t> v;
+    for (const char* c : { "B", "G", "R" }) {
+        putBytes(v, c, 2);
+        putI32(v, 2);                         // FLOAT
+        const uint8_t linear_reserved[4] = {};
+        putBytes(v, linear_reserved, 4);
+        putI32(v, 1);                         // x sampling
+        putI32(v, 1);                         // y sampling
+    }
+    v.push_back(0);
+    putAttribute(h, "channels", "chlist", v);
+
+    putAttribute(h, "compression", "compression", { 0 });   // NO_COMPRESSION
+
+    v.clear();
+    putI32(v, 0); putI32(v, 0); putI32(v, width - 1); putI32(v, height - 1);
+    putAttribute(h, "dataWindow", "box2i", v);
+    putAttribute(h, "displayWindow", "box2i", v);
+
+    putAttribute(h, "lineOrder", "lineOrder", { 0 });       // INCREASING_Y
+
+    float one = 1.0f, center[2] = { 0.0f, 0.0f };
+    v.clear(); putBytes(v, &one, 4);
+    putAttribute(h, "pixelAspectRatio", "float", v);
+    v.clear(); putBytes(v, center, 8);
+    putAttribute(h, "screenWindowCenter", "v2f", v);
+    v.clear(); putBytes(v, &one, 4);
+    putAttribute(h, "screenWindowWidth", "float", v);
+
+    h.push_back(0);   // end of header
+    return h;
+}
+
+class ExrStream : public ImageStream {
+public:
+    ExrStream(FILE* f, int width, int height)
+        : f(f), width(width), height(height),
+          chunk(8 + static_cast<size_t>(width) * 3 * sizeof(float)) {
+        std::vector<uint8_t> header = exrHeader(width, height);
+
+        // Offset table: chunk y starts after the header, the table and y chunks
+        uint64_t first = header.size() + sizeof(uint64_t) * static_cast<uint64_t>(height);
+        for (int y = 0; y < height; ++y) {
+            uint64_t offset = first + chunk.size() * static_cast<uint64_t>(y);
+            putBytes(header, &offset, 8);
+        }
+        ok = fwrite(header.data(), 1, header.size(), f) == header.size();
+    }
+    ~ExrStream() override { if (f) fclose(f); }
+
+    // rows: RGB32F. Each row is split into its B, G and R planes.
+    bool writeRows(const uint8_t* rows, int n) override {
+        const float* src = reinterpret_cast<const float*>(rows);
+        int32_t data_bytes = static_cast<int32_t>(chunk.size() - 8);
+        for (int y = 0; y < n && ok; ++y, ++next_row, src += 3 * width) {
+            memcpy(chunk.data(), &next_row, 4);
+            memcpy(chunk.data() + 4, &data_bytes, 4);
+            float* b = reinterpret_cast<float*>(chunk.data() + 8);
+            float* g = b + width;
+            float* r = g + width;
+            for (int i = 0; i < width; ++i) {
+                r[i] = src[3 * i + 0];
+                g[i] = src[3 * i + 1];
+                b[i] = src[3 * i + 2];
+            }
+            ok = fwrite(chunk.data(), 1, chunk.size(), f) == chunk.size();
+        }
+        return ok;
+    }
+
+    bool close() override {
+        ok = fclose(f) == 0 && ok && next_row == height;
+        f = nullptr;
+        return ok;
+    }
+
+private:
+    FILE* f;
+    int width, height;
+    int32_t next_row = 0;
+    std::vector<uint8_t> chunk;
+    bool ok;
+};
+
+// ----------------- PNG -----------------
+
+class PngImageStream : public ImageStream {
+public:
+    bool open(const char* fname, int width, int height) { return png.open(fname, width, height); }
+    bool writeRows(const uint8_t* rows, int n) override { return png.writeRows(rows, n); }
+    bool close() override { return png.close(); }
+
+private:
+    PngStream png;
+};
+
+bool ImageStreamSupported(const std::string& fname) {
+    return IsRasterFormat(fname) || hasExtension(fname, ".png") || hasExtension(fname, ".exr");
+}
+
+std::unique_ptr<ImageStream> OpenImageStream(const char* fname, int width, int height) {
+    if (hasExtension(fname, ".png")) {
+        std::unique_ptr<PngImageStream> png(new PngImageStream());
+        if (!png->open(fname, width, height)) return nullptr;
+        return png;
+    }
+    if (!ImageStreamSupported(fname)) return nullptr;
+
+    FILE* f = fopen(fname, "wb");
+    if (!f) return nullptr;
+    if (hasExtension(fname, ".exr")) return std::unique_ptr<ImageStream>(new ExrStream(f, width, height));
+    return std::unique_ptr<ImageStream>(new RasterStream(f, fname, width, height));
+}
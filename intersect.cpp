@@ -1,4 +1,6 @@
 #include "Include/intersect.h"
+#include "Include/perfCounters.h"
+#include "Include/stats.h"
 #include <limits>
 
 double intersectSphere(const Ray &ray, const Sphere &s) {
@@ -57,24 +59,32 @@ double rayTriangleIntersect(const Ray &ray, const Triangle &triangle)
 }
 
 bool FindIntersection(const Scene &scene, const Ray &ray, HitInfo &hit) {
+    KernelScope kernel(Kernel::Intersect);
     double closest_t = std::numeric_limits<double>::max();
     const Primitive* closest_prim = nullptr;
+    int closest_index = -1;
     double t_min = 0.0001; // Epsilon to prevent self-intersection acne
+    int n_spheres = static_cast<int>(scene.spheres.size());
+    STAT_ADD(hit_sphere_tests, n_spheres);
+    STAT_ADD(hit_triangle_tests, scene.triangles.size());
 
     // 1. Check Spheres
-    for (const auto& sphere : scene.spheres) {
+    for (int i = 0; i < n_spheres; ++i) {
+        const Sphere* sphere = scene.spheres[i];
         double t_d = intersectSphere(ray, *sphere); 
         if (t_d != std::numeric_limits<double>::infinity()) {
             double t_f = t_d;
             if (t_f > t_min && t_f < closest_t) {
                 closest_t = t_f;
                 closest_prim = sphere;
+                closest_index = i;
             }
         }
     }
 
     // 2. Check Triangles
-    for (const auto& tri : scene.triangles) {
+    for (int i = 0; i < static_cast<int>(scene.triangles.size()); ++i) {
+        const Triangle* tri = scene.triangles[i];
         double t_d = rayTriangleIntersect(ray, *tri);
 
         // rayTriangleIntersect returns infinity on miss
@@ -83,6 +93,7 @@ bool FindIntersection(const Scene &scene, const Ray &ray, HitInfo &hit) {
             if (t_f > t_min && t_f < closest_t) {
                 closest_t = t_f;
                 closest_prim = tri;
+                closest_index = n_spheres + i;
             }
         }
     }
@@ -99,6 +110,7 @@ bool FindIntersection(const Scene &scene, const Ray &ray, HitInfo &hit) {
 
         // Retrieve material
         hit.material = closest_prim->getMaterial();
+        hit.primitive = closest_index;
 
         return true;
     }
@@ -106,3 +118,39 @@ bool FindIntersection(const Scene &scene, const Ray &ray, HitInfo &hit) {
     return false;
 }
 
+double intersectPrimitive(const Scene &scene, const Ray &ray, int index) {
+    int n_spheres = static_cast<int>(scene.spheres.size());
+    if (index < n_spheres) {
+        STAT_INC(shadow_sphere_tests);
+        return intersectSphere(ray, *scene.spheres[index]);
+    }
+    STAT_INC(shadow_triangle_tests);
+    return rayTriangleIntersect(ray, *scene.triangles[index - n_spheres]);
+}
+
+bool FindOcclusion(const Scene &scene, const Ray &ray, double max_distance, int &occluder) {
+    double t_min = 0.0001; // same epsilon as FindIntersection
+    int n_spheres = static_cast<int>(scene.spheres.size());
+
+    for (int i = 0; i < n_spheres; ++i) {
+        double t = intersectSphere(ray, *scene.spheres[i]);
+        if (t > t_min && t < max_distance) {
+            STAT_ADD(shadow_sphere_tests, i + 1);
+            occluder = i;
+            return true;
+        }
+    }
+    STAT_ADD(shadow_sphere_tests, n_spheres);
+
+    for (int i = 0; i < static_cast<int>(scene.triangles.size()); ++i) {
+        double t = rayTriangleIntersect(ray, *scene.triangles[i]);
+        if (t > t_min && t < max_distance) {
+            STAT_ADD(shadow_triangle_tests, i + 1);
+            occluder = n_spheres + i;
+            return true;
+        }
+    }
+    STAT_ADD(shadow_triangle_tests, scene.triangles.size());
+
+    return false;
+}
@@ -0,0 +1,448 @@
+// Micro-benchmarks of the intersection and shading kernels, timed in
+// isolation on randomized and scene-derived inputs. A separate program:
+// see the README for its compile command.
+//
+//   kernel_bench <scenefile> [--rays n] [--reps n] [--warmup n] [--seed n] [--filter s]
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Include/intersect.h"
+#include "Include/lighting.h"
+#include "Include/render.h"
+#include "Include/scene.h"
+
+// Primitives tested per ray by the primitive kernels, and the size of the
+// random primitive sets
+static constexpr int BENCH_PRIMITIVES = 256;
+
+// Keeps results alive so the timed loops are not optimized away
+static volatile double g_sink = 0.0;
+
+struct BenchOptions {
+    int rays = 4096;     // rays per input set
+    int reps = 10;
+    int warmup = 3;
+    uint64_t seed = 1;
+    std::string filter;  // run kernels whose name contains this
+};
+
+// ----------------- Inputs -----------------
+struct ShadowQuery {
+    Ray ray;
+    double distance;
+    const Light* light;
+};
+
+struct ShadedHit {
+    Ray ray;
+    HitInfo hit;
+};
+
+struct BenchInputs {
+    std::vector<Ray> camera;     // random pixels of the scene's camera
+    std::vector<Ray> random;     // random origins in the scene bounds, random directions
+    std::vector<ShadedHit> hits; // primary hits of camera rays
+    std::vector<ShadowQuery> shadow;          // hit -> random light that reaches it
+    std::vector<const Light*> hit_lights;     // one random light per hit
+    std::vector<double> uniforms;             // random numbers in [0, 1) for light sampling
+
+    // Random primitives in [-1, 1]^3 and rays through that box
+    std::vector<Sphere>   rand_spheres;
+    std::vector<Triangle> rand_triangles;
+    std::vector<Ray>      rand_rays;
+    Material material;
+
+    // Up to BENCH_PRIMITIVES of the scene's own primitives
+    std::vector<const Sphere*>   scene_spheres;
+    std::vector<const Triangle*> scene_triangles;
+};
+
+static Direction3 RandomDirection(std::mt19937_64& rng) {
+    std::normal_distribution<double> n(0.0, 1.0);
+    Direction3 d(n(rng), n(rng), n(rng));
+    return d.length() > 0.0 ? d.normalized() : Direction3(0, 0, 1);
+}
+
+static void SceneBounds(const Scene& scene, Point3& lo, Point3& hi) {
+    const double INF = std::numeric_limits<double>::infinity();
+    lo = Point3(INF, INF, INF);
+    hi = Point3(-INF, -INF, -INF);
+    auto grow = [&](const Point3& p, double r) {
+        lo = Point3(std::min(lo.x, p.x - r), std::min(lo.y, p.y - r), std::min(lo.z, p.z - r));
+        hi = Point3(std::max(hi.x, p.x + r), std::max(hi.y, p.y + r), std::max(hi.z, p.z + r));
+    };
+    for (const Sphere* s : scene.spheres) grow(s->center, s->radius);
+    for (const Triangle* t : scene.triangles) {
+        grow(t->v1, 0.0);
+        grow(t->v2, 0.0);
+        grow(t->v3, 0.0);
+    }
+    if (lo.x > hi.x) {
+        lo = Point3(-1, -1, -1);
+        hi = Point3(1, 1, 1);
+    }
+}
+
+static void BuildInputs(const RenderContext& ctx, const BenchOptions& opt, BenchInputs& in) {
+    const Scene& scene = ctx.scene;
+    std::mt19937_64 rng(opt.seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    // Camera rays through pixel centers, as RenderRows builds them
+    for (int k = 0; k < opt.rays; ++k) {
+        int i = static_cast<int>(unit(rng) * ctx.width);
+        int j = static_cast<int>(unit(rng) * ctx.height);
+        float v = ctx.halfH - static_cast<float>(j) + 0.5f;
+        Point3 p = ctx.cam_origin + v * scene.camera_up
+                 + (ctx.halfW + 0.5f) * scene.camera_right + i * ctx.step_x;
+        in.camera.push_back(Ray(scene.camera_pos, p - scene.camera_pos));
+    }
+
+    Point3 lo, hi;
+    SceneBounds(scene, lo, hi);
+    for (int k = 0; k < opt.rays; ++k) {
+        Point3 o(lo.x + unit(rng) * (hi.x - lo.x), lo.y + unit(rng) * (hi.y - lo.y),
+                 lo.z + unit(rng) * (hi.z - lo.z));
+        in.random.push_back(Ray(o, RandomDirection(rng)));
+    }
+
+    // Shading inputs from the camera rays' hits
+    for (const Ray& ray : in.camera) {
+        HitInfo hit;
+        if (FindIntersection(scene, ray, hit)) in.hits.push_back({ ray, hit });
+    }
+    for (const ShadedHit& h : in.hits) {
+        if (scene.lights.empty()) break;
+        const Light* light = scene.lights[static_cast<size_t>(unit(rng) * scene.lights.size())];
+        in.hit_lights.push_back(light);
+
+        Direction3 N = h.hit.normal.normalized();
+        Point3 p = h.hit.point + N * 1e-4;
+        Direction3 L;
+        double distance;
+        Color radiance;
+        if (light->illuminate(p, L, distance, radiance) && dot(N, L) > 0.0) {
+            in.shadow.push_back({ Ray(p, L), distance, light });
+        }
+    }
+
+    for (int k = 0; k < opt.rays; ++k) in.uniforms.push_back(unit(rng));
+
+    // Random primitives, and rays aimed through their box
+    in.material.shading = MaterialClass::Diffuse;
+    for (int k = 0; k < BENCH_PRIMITIVES; ++k) {
+        Sphere s;
+        s.center = Point3(2 * unit(rng) - 1, 2 * unit(rng) - 1, 2 * unit(rng) - 1);
+        s.radius = 0.05 + 0.15 * unit(rng);
+        s.material = &in.material;
+        in.rand_spheres.push_back(s);
+
+        Triangle t;
+        t.v1 = Point3(2 * unit(rng) - 1, 2 * unit(rng) - 1, 2 * unit(rng) - 1);
+        t.v2 = t.v1 + 0.3 * RandomDirection(rng);
+        t.v3 = t.v1 + 0.3 * RandomDirection(rng);
+        t.triPlane = cross(t.v2 - t.v1, t.v3 - t.v1).normalized();
+        t.n1 = t.n2 = t.n3 = t.triPlane;
+        t.material = &in.material;
+        in.rand_triangles.push_back(t);
+    }
+    for (int k = 0; k < opt.rays; ++k) {
+        Point3 o = Point3(0, 0, 0) + 3.0 * RandomDirection(rng);
+        Point3 target(2 * unit(rng) - 1, 2 * unit(rng) - 1, 2 * unit(rng) - 1);
+        in.rand_rays.push_back(Ray(o, target - o));
+    }
+
+    // Spread over the scene's lists
+    size_t stride = std::max<size_t>(1, scene.spheres.size() / BENCH_PRIMITIVES);
+    for (size_t k = 0; k < scene.spheres.size() && in.scene_spheres.size() < BENCH_PRIMITIVES; k += stride) {
+        in.scene_spheres.push_back(scene.spheres[k]);
+    }
+    stride = std::max<size_t>(1, scene.triangles.size() / BENCH_PRIMITIVES);
+    for (size_t k = 0; k < scene.triangles.size() && in.scene_triangles.size() < BENCH_PRIMITIVES; k += stride) {
+        in.scene_triangles.push_back(scene.triangles[k]);
+    }
+}
+
+// ----------------- Measurement -----------------
+struct BenchResult {
+    std::string kernel, input, unit;
+    uint64_t ops = 0;                  // per repetition
+    double mean = 0, ci95 = 0, min = 0;  // ns per op
+};
+
+// Two-sided 95% Student t quantile for df degrees of freedom
+static double TCritical95(int df) {
+    static const double table[30] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (df < 1) return 0.0;
+    return df <= 30 ? table[df - 1] : 1.960;
+}
+
+// pass runs the kernel over its whole input once and returns a checksum
+template <class F>
+static void Measure(const std::string& kernel, const std::string& input, const std::string& unit,
+                    uint64_t ops, const BenchOptions& opt, std::vector<BenchResult>& results,
+                    F&& pass) {
+    if (!opt.filter.empty() && kernel.find(opt.filter) == std::string::npos) return;
+    if (ops == 0) {
+        std::cout << "[BENCH] " << std::left << std::setw(25) << kernel << std::setw(8) << input
+                  << std::right << "  skipped (no inputs in this scene)\n";
+        return;
+    }
+
+    for (int k = 0; k < opt.warmup; ++k) g_sink = g_sink + pass();
+
+    std::vector<double> ns;
+    for (int k = 0; k < opt.reps; ++k) {
+        auto t0 = std::chrono::steady_clock::now();
+        double sum = pass();
+        auto t1 = std::chrono::steady_clock::now();
+        g_sink = g_sink + sum;
+        ns.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count() / ops);
+    }
+
+    BenchResult r;
+    r.kernel = kernel;
+    r.input = input;
+    r.unit = unit;
+    r.ops = ops;
+    r.min = *std::min_element(ns.begin(), ns.end());
+    for (double v : ns) r.mean += v / ns.size();
+    double var = 0.0;
+    for (double v : ns) var += (v - r.mean) * (v - r.mean);
+    int n = static_cast<int>(ns.size());
+    if (n > 1) r.ci95 = TCritical95(n - 1) * std::sqrt(var / (n - 1)) / std::sqrt(double(n));
+
+    std::cout << "[BENCH] " << std::left << std::setw(25) << kernel << std::setw(8) << input
+              << std::setw(7) << unit << std::right << std::setw(10) << ops
+              << std::setw(11) << r.mean << std::setw(9) << r.ci95 << std::setw(11) << r.min
+              << std::setw(11) << std::setprecision(3) << 1e3 / r.mean << std::setprecision(2) << "\n";
+    results.push_back(r);
+}
+
+// ----------------- Kernels -----------------
+static void RunBenchmarks(const Scene& scene, const BenchInputs& in, const BenchOptions& opt,
+                          std::vector<BenchResult>& results) {
+    const double INF = std::numeric_limits<double>::infinity();
+
+    // Ray-primitive tests: every ray against every primitive of a set
+    auto spheres = [&](const std::vector<Ray>& rays, auto& set) {
+        return [&]() {
+            double sum = 0.0;
+            for (const Ray& ray : rays) {
+                for (const auto& s : set) {
+                    double t = intersectSphere(ray, *s);
+                    if (t != INF) sum += t;
+                }
+            }
+            return sum;
+        };
+    };
+    auto triangles = [&](const std::vector<Ray>& rays, auto& set) {
+        return [&]() {
+            double sum = 0.0;
+            for (const Ray& ray : rays) {
+                for (const auto& t : set) {
+                    double d = rayTriangleIntersect(ray, *t);
+                    if (d != INF) sum += d;
+                }
+            }
+            return sum;
+        };
+    };
+    std::vector<const Sphere*> rand_spheres;
+    std::vector<const Triangle*> rand_triangles;
+    for (const Sphere& s : in.rand_spheres) rand_spheres.push_back(&s);
+    for (const Triangle& t : in.rand_triangles) rand_triangles.push_back(&t);
+
+    Measure("intersectSphere", "random", "test", in.rand_rays.size() * rand_spheres.size(), opt,
+            results, spheres(in.rand_rays, rand_spheres));
+    Measure("intersectSphere", "scene", "test", in.camera.size() * in.scene_spheres.size(), opt,
+            results, spheres(in.camera, in.scene_spheres));
+    Measure("rayTriangleIntersect", "random", "test", in.rand_rays.size() * rand_triangles.size(), opt,
+            results, triangles(in.rand_rays, rand_triangles));
+    Measure("rayTriangleIntersect", "scene", "test", in.camera.size() * in.scene_triangles.size(), opt,
+            results, triangles(in.camera, in.scene_triangles));
+
+    // Closest hit over the whole scene
+    auto closest = [&](const std::vector<Ray>& rays) {
+        return [&]() {
+            double sum = 0.0;
+            HitInfo hit;
+            for (const Ray& ray : rays) {
+                if (FindIntersection(scene, ray, hit)) sum += hit.distance;
+            }
+            return sum;
+        };
+    };
+    Measure("FindIntersection", "camera", "ray", in.camera.size(), opt, results, closest(in.camera));
+    Measure("FindIntersection", "random", "ray", in.random.size(), opt, results, closest(in.random));
+
+    // Shadow rays: the scan over every primitive, and the light's own
+    // query (the light-space grid for directional lights)
+    Measure("FindOcclusion", "shadow", "ray", in.shadow.size(), opt, results, [&]() {
+        double sum = 0.0;
+        for (const ShadowQuery& q : in.shadow) {
+            int occluder = -1;
+            sum += FindOcclusion(scene, q.ray, q.distance, occluder);
+        }
+        return sum;
+    });
+    Measure("Light::occluded", "shadow", "ray", in.shadow.size(), opt, results, [&]() {
+        double sum = 0.0;
+        for (const ShadowQuery& q : in.shadow) {
+            int occluder = -1;
+            sum += q.light->occluded(scene, q.ray, q.distance, occluder);
+        }
+        return sum;
+    });
+
+    // Light tree traversal as the renderer does it: importance sampling
+    // with light_samples, otherwise cutoff culling
+    const LightTree& tree = scene.lightTree;
+    bool sampling = scene.light_samples > 0;
+    Measure("LightTree::sample", "hits", "sample",
+            tree.empty() || !sampling ? 0 : in.hits.size() * scene.light_samples, opt, results, [&]() {
+        double sum = 0.0;
+        size_t u = 0;
+        for (const ShadedHit& h : in.hits) {
+            Direction3 N = h.hit.normal.normalized();
+            Point3 p = h.hit.point + N * 1e-4;
+            bool cosine = h.hit.material->shading == MaterialClass::Diffuse;
+            for (int s = 0; s < scene.light_samples; ++s) {
+                double pdf = 0.0;
+                if (tree.sample(p, N, cosine, in.uniforms[u++ % in.uniforms.size()], pdf)) sum += pdf;
+            }
+        }
+        return sum;
+    });
+    Measure("LightTree::forEachLight", "hits", "hit",
+            tree.empty() || sampling ? 0 : in.hits.size(), opt, results, [&]() {
+        double sum = 0.0;
+        for (const ShadedHit& h : in.hits) {
+            const Material* m = h.hit.material;
+            Direction3 N = h.hit.normal.normalized();
+            Point3 p = h.hit.point + N * 1e-4;
+            bool cosine = m->shading == MaterialClass::Diffuse;
+            double reflectance = std::max({ m->diffuse.r, m->diffuse.g, m->diffuse.b });
+            if (!cosine) reflectance += std::max({ m->specular.r, m->specular.g, m->specular.b });
+            tree.forEachLight(p, N, cosine, reflectance, scene.light_cutoff,
+                              [&](const Light&) { sum += 1.0; });
+        }
+        return sum;
+    });
+
+    // One light at one hit, shadow ray included
+    Measure("getContribution", "hits", "light", in.hit_lights.size(), opt, results, [&]() {
+        ResetShadowCache(scene);
+        double sum = 0.0;
+        for (size_t k = 0; k < in.hit_lights.size(); ++k) {
+            HitInfo hit = in.hits[k].hit;
+            Color c = in.hit_lights[k]->getContribution(scene, in.hits[k].ray, hit);
+            sum += c.r + c.g + c.b;
+        }
+        return sum;
+    });
+
+    // Full shading of a primary hit: every light and the secondary rays
+    Measure("ApplyLighting", "hits", "hit", in.hits.size(), opt, results, [&]() {
+        ResetShadowCache(scene);
+        double sum = 0.0;
+        for (const ShadedHit& h : in.hits) {
+            Ray ray = h.ray;
+            HitInfo hit = h.hit;
+            Color c = ApplyLighting(scene, ray, hit, scene.max_depth);
+            sum += c.r + c.g + c.b;
+        }
+        return sum;
+    });
+}
+
+int main(int argc, char** argv) {
+    // The scene loader times its build phase with MPI_Wtime
+    MPI_Init(&argc, &argv);
+
+    if (argc < 2) {
+        std::cout << "Usage: kernel_bench <scenefile> [options]\n"
+                  << "  --rays <n>     rays per input set (default 4096)\n"
+                  << "  --reps <n>     timed repetitions (default 10)\n"
+                  << "  --warmup <n>   untimed repetitions first (default 3)\n"
+                  << "  --seed <n>     seed of the random inputs (default 1)\n"
+                  << "  --filter <s>   only kernels whose name contains s\n";
+        MPI_Finalize();
+        return 0;
+    }
+
+    BenchOptions opt;
+    for (int a = 2; a < argc; ++a) {
+        std::string o = argv[a];
+        if (o == "--rays" && a + 1 < argc) {
+            opt.rays = std::max(1, std::atoi(argv[++a]));
+        } else if (o == "--reps" && a + 1 < argc) {
+            opt.reps = std::max(1, std::atoi(argv[++a]));
+        } else if (o == "--warmup" && a + 1 < argc) {
+            opt.warmup = std::max(0, std::atoi(argv[++a]));
+        } else if (o == "--seed" && a + 1 < argc) {
+            opt.seed = std::strtoull(argv[++a], nullptr, 10);
+        } else if (o == "--filter" && a + 1 < argc) {
+            opt.filter = argv[++a];
+        } else {
+            std::cerr << "Warning: unknown option " << o << std::endl;
+        }
+    }
+
+    int width, height;
+    std::string imgName;
+    Scene scene = parseSceneFile(argv[1], width, height, imgName);
+    RenderContext ctx(scene, width, height);
+
+    BenchInputs inputs;
+    BuildInputs(ctx, opt, inputs);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "[BENCH] " << argv[1] << ": " << scene.spheres.size() << " spheres, "
+              << scene.triangles.size() << " triangles, " << scene.lights.size() << " lights; "
+              << opt.rays << " rays per set (" << inputs.hits.size() << " hits, "
+              << inputs.shadow.size() << " shadow rays), seed " << opt.seed << ", "
+              << opt.warmup << " warmups, " << opt.reps << " repetitions\n";
+    std::cout << "[BENCH] " << std::left << std::setw(25) << "kernel" << std::setw(8) << "input"
+              << std::setw(7) << "op" << std::right << std::setw(10) << "ops" << std::setw(11) << "ns/op"
+              << std::setw(9) << "+-95%" << std::setw(11) << "min ns" << std::setw(11) << "Mops/s" << "\n";
+
+    std::vector<BenchResult> results;
+    RunBenchmarks(scene, inputs, opt, results);
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3) << "{\"scene\":\"" << argv[1] << "\",\"seed\":" << opt.seed
+         << ",\"reps\":" << opt.reps << ",\"results\":[";
+    for (size_t k = 0; k < results.size(); ++k) {
+        const BenchResult& r = results[k];
+        json << (k ? "," : "") << "{\"kernel\":\"" << r.kernel << "\",\"input\":\"" << r.input
+             << "\",\"op\":\"" << r.unit << "\",\"ops\":" << r.ops << ",\"ns_per_op\":" << r.mean
+             << ",\"ci95\":" << r.ci95 << ",\"min\":" << r.min << ",\"mops_per_s\":" << 1e3 / r.mean << "}";
+    }
+    json << "]}";
+    std::cout << "[BENCH][JSON] " << json.str() << "\n";
+
+    for (Sphere* s : scene.spheres)     delete s;
+    for (Triangle* t : scene.triangles) delete t;
+    for (Material* m : scene.materials) delete m;
+    for (Light* l : scene.lights)       delete l;
+
+    MPI_Finalize();
+    return 0;
+}
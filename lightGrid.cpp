@@ -0,0 +1,128 @@
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "Include/lightGrid.h"
+#include "Include/scene.h"
+
+// Slack on the influence test so rounding never drops a light that
+// ShadeLight would keep, and margin for the shadow-ray offset of hit points
+static constexpr double RADIUS_SLACK = 1e-9;
+static constexpr double HIT_MARGIN   = 1e-3;
+
+static inline double maxChannel(const Color& c) {
+    return std::max(std::fabs(c.r), std::max(std::fabs(c.g), std::fabs(c.b)));
+}
+
+static double boxDistance2(const Point3& p, const Point3& lo, const Point3& hi) {
+    double dx = std::max(0.0, std::max(lo.x - p.x, p.x - hi.x));
+    double dy = std::max(0.0, std::max(lo.y - p.y, p.y - hi.y));
+    double dz = std::max(0.0, std::max(lo.z - p.z, p.z - hi.z));
+    return dx * dx + dy * dy + dz * dz;
+}
+
+static void growBox(Point3& lo, Point3& hi, const Point3& p) {
+    lo = Point3(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+    hi = Point3(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+}
+
+void LightGrid::build(const Scene& scene) {
+    const double INF = std::numeric_limits<double>::infinity();
+
+    lights.clear();
+    centers.clear();
+    radius2.clear();
+    cellStart.clear();
+    cellLights.clear();
+
+    // Largest reflectance any hit can have: bounds the ShadeLight cutoff test
+    double reflectance = 0.0;
+    for (const Material* m : scene.materials) {
+        reflectance = std::max(reflectance, maxChannel(m->diffuse) + maxChannel(m->specular));
+    }
+
+    // Influence radius: power * reflectance / d^2 <= light_cutoff beyond it
+    for (const Light* light : scene.lights) {
+        LightBounds b;
+        lights.push_back(light);
+        if (light->getBounds(b)) {
+            centers.push_back(b.position);
+            radius2.push_back(b.power * reflectance / scene.light_cutoff * (1.0 + RADIUS_SLACK));
+        } else {
+            centers.push_back(Point3());
+            radius2.push_back(INF);
+        }
+    }
+
+    // Grid bounds: every hit point lies on a primitive
+    bmin = Point3(INF, INF, INF);
+    bmax = Point3(-INF, -INF, -INF);
+    for (const Sphere* s : scene.spheres) {
+        Direction3 r(s->radius, s->radius, s->radius);
+        growBox(bmin, bmax, s->center - r);
+        growBox(bmin, bmax, s->center + r);
+    }
+    for (const Triangle* t : scene.triangles) {
+        growBox(bmin, bmax, t->v1);
+        growBox(bmin, bmax, t->v2);
+        growBox(bmin, bmax, t->v3);
+    }
+    if (bmin.x > bmax.x) {
+        nx = ny = nz = 0;
+        return;
+    }
+    Direction3 margin(HIT_MARGIN, HIT_MARGIN, HIT_MARGIN);
+    bmin = bmin - margin;
+    bmax = bmax + margin;
+
+    Direction3 ext = bmax - bmin;
+    double longest = std::max(ext.x, std::max(ext.y, ext.z));
+    nx = std::max(1, static_cast<int>(std::ceil(LIGHT_GRID_RES * ext.x / longest)));
+    ny = std::max(1, static_cast<int>(std::ceil(LIGHT_GRID_RES * ext.y / longest)));
+    nz = std::max(1, static_cast<int>(std::ceil(LIGHT_GRID_RES * ext.z / longest)));
+    cellSize = Direction3(ext.x / nx, ext.y / ny, ext.z / nz);
+
+    cellStart.reserve(nx * ny * nz + 1);
+    std::vector<const Light*> cell;
+    for (int z = 0; z < nz; ++z) {
+        for (int y = 0; y < ny; ++y) {
+            for (int x = 0; x < nx; ++x) {
+                Point3 lo = bmin + Direction3(x * cellSize.x, y * cellSize.y, z * cellSize.z);
+                Point3 hi = lo + cellSize;
+                lightsInBox(lo, hi, cell);
+                cellStart.push_back(static_cast<int>(cellLights.size()));
+                cellLights.insert(cellLights.end(), cell.begin(), cell.end());
+            }
+        }
+    }
+    cellStart.push_back(static_cast<int>(cellLights.size()));
+}
+
+void LightGrid::lightsInBox(const Point3& lo, const Point3& hi,
+                            std::vector<const Light*>& out) const {
+    out.clear();
+    Direction3 margin(HIT_MARGIN, HIT_MARGIN, HIT_MARGIN);
+    Point3 blo = lo - margin;
+    Point3 bhi = hi + margin;
+
+    for (size_t i = 0; i < lights.size(); ++i) {
+        if (radius2[i] == std::numeric_limits<double>::infinity() ||
+            boxDistance2(centers[i], blo, bhi) < radius2[i]) {
+            out.push_back(lights[i]);
+        }
+    }
+}
+
+bool LightGrid::cellLightsAt(const Point3& p, const Light* const*& begin,
+                             const Light* const*& end) const {
+    if (cellStart.empty()) return false;
+
+    int x = static_cast<int>(std::floor((p.x - bmin.x) / cellSize.x));
+    int y = static_cast<int>(std::floor((p.y - bmin.y) / cellSize.y));
+    int z = static_cast<int>(std::floor((p.z - bmin.z) / cellSize.z));
+    if (x < 0 || y < 0 || z < 0 || x >= nx || y >= ny || z >= nz) return false;
+
+    int c = (z * ny + y) * nx + x;
+    begin = cellLights.data() + cellStart[c];
+    end   = cellLights.data() + cellStart[c + 1];
+    return true;
+}
@@ -0,0 +1,115 @@
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "Include/lightSpaceGrid.h"
+#include "Include/intersect.h"
+#include "Include/scene.h"
+#include "Include/stats.h"
+
+// Cells per side for n primitives is about sqrt(2n), capped at this
+static constexpr int LIGHT_SPACE_MAX_RES = 1024;
+
+void LightSpaceGrid::build(const Scene& scene, const Direction3& L) {
+    cellStart.clear();
+    items.clear();
+
+    size_t n_spheres = scene.spheres.size();
+    size_t n_items   = n_spheres + scene.triangles.size();
+    if (n_items == 0) return;
+
+    Direction3 w = L.normalized();
+    Direction3 a = std::fabs(w.x) < 0.9 ? Direction3(1, 0, 0) : Direction3(0, 1, 0);
+    u = cross(a, w).normalized();
+    v = cross(w, u).normalized();
+
+    // Projected bounds of every primitive
+    std::vector<double> lo_u(n_items), hi_u(n_items), lo_v(n_items), hi_v(n_items);
+    for (size_t i = 0; i < n_spheres; ++i) {
+        const Sphere* s = scene.spheres[i];
+        double cu = dot(s->center, u);
+        double cv = dot(s->center, v);
+        lo_u[i] = cu - s->radius;  hi_u[i] = cu + s->radius;
+        lo_v[i] = cv - s->radius;  hi_v[i] = cv + s->radius;
+    }
+    for (size_t k = 0; k < scene.triangles.size(); ++k) {
+        const Triangle* t = scene.triangles[k];
+        size_t i = n_spheres + k;
+        double pu[3] = { dot(t->v1, u), dot(t->v2, u), dot(t->v3, u) };
+        double pv[3] = { dot(t->v1, v), dot(t->v2, v), dot(t->v3, v) };
+        lo_u[i] = std::min(pu[0], std::min(pu[1], pu[2]));
+        hi_u[i] = std::max(pu[0], std::max(pu[1], pu[2]));
+        lo_v[i] = std::min(pv[0], std::min(pv[1], pv[2]));
+        hi_v[i] = std::max(pv[0], std::max(pv[1], pv[2]));
+    }
+
+    umin = *std::min_element(lo_u.begin(), lo_u.end());
+    vmin = *std::min_element(lo_v.begin(), lo_v.end());
+    double umax = *std::max_element(hi_u.begin(), hi_u.end());
+    double vmax = *std::max_element(hi_v.begin(), hi_v.end());
+
+    // Widen every bound so projection rounding never misses a primitive
+    double margin = 1e-6 * std::max(umax - umin, vmax - vmin) + 1e-9;
+    umin -= margin;  vmin -= margin;
+    umax += margin;  vmax += margin;
+
+    int res = static_cast<int>(std::ceil(std::sqrt(2.0 * n_items)));
+    res = std::max(1, std::min(res, LIGHT_SPACE_MAX_RES));
+    double longest = std::max(umax - umin, vmax - vmin);
+    nu = std::max(1, static_cast<int>(std::ceil(res * (umax - umin) / longest)));
+    nv = std::max(1, static_cast<int>(std::ceil(res * (vmax - vmin) / longest)));
+    cellU = (umax - umin) / nu;
+    cellV = (vmax - vmin) / nv;
+
+    auto cellRange = [](double lo, double hi, double base, double size, int n,
+                        int& c0, int& c1) {
+        c0 = std::max(0, std::min(n - 1, static_cast<int>(std::floor((lo - base) / size))));
+        c1 = std::max(0, std::min(n - 1, static_cast<int>(std::floor((hi - base) / size))));
+    };
+
+    // Count, then fill the CSR lists
+    std::vector<int> count(nu * nv + 1, 0);
+    for (size_t i = 0; i < n_items; ++i) {
+        int u0, u1, v0, v1;
+        cellRange(lo_u[i] - margin, hi_u[i] + margin, umin, cellU, nu, u0, u1);
+        cellRange(lo_v[i] - margin, hi_v[i] + margin, vmin, cellV, nv, v0, v1);
+        for (int cv = v0; cv <= v1; ++cv)
+            for (int cu = u0; cu <= u1; ++cu)
+                ++count[cv * nu + cu];
+    }
+
+    cellStart.assign(nu * nv + 1, 0);
+    for (int c = 0; c < nu * nv; ++c) cellStart[c + 1] = cellStart[c] + count[c];
+    items.resize(cellStart.back());
+
+    std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+    for (size_t i = 0; i < n_items; ++i) {
+        int u0, u1, v0, v1;
+        cellRange(lo_u[i] - margin, hi_u[i] + margin, umin, cellU, nu, u0, u1);
+        cellRange(lo_v[i] - margin, hi_v[i] + margin, vmin, cellV, nv, v0, v1);
+        for (int cv = v0; cv <= v1; ++cv)
+            for (int cu = u0; cu <= u1; ++cu)
+                items[fill[cv * nu + cu]++] = static_cast<int>(i);
+    }
+}
+
+bool LightSpaceGrid::occluded(const Scene& scene, const Ray& ray,
+                              double max_distance, int& occluder) const {
+    const double t_min = 0.0001;
+    STAT_INC(shadow_grid_rays);
+
+    int cu = static_cast<int>(std::floor((dot(ray.origin, u) - umin) / cellU));
+    int cv = static_cast<int>(std::floor((dot(ray.origin, v) - vmin) / cellV));
+
+    // Outside the projected bounds of the scene: nothing can block
+    if (cu < 0 || cv < 0 || cu >= nu || cv >= nv) return false;
+
+    int c = cv * nu + cu;
+    for (int k = cellStart[c]; k < cellStart[c + 1]; ++k) {
+        double t = intersectPrimitive(scene, ray, items[k]);
+        if (t > t_min && t < max_distance) {
+            occluder = items[k];
+            return true;
+        }
+    }
+    return false;
+}
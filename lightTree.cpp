@@ -0,0 +1,236 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include "Include/lightTree.h"
+
+typedef std::pair<LightBounds, const Light*> LightItem;
+
+// Slack on angle tests so rounding never rejects a light that can reach p
+static constexpr double ANGLE_SLACK = 1e-6;
+
+static inline double clampCos(double c) {
+    return std::max(-1.0, std::min(1.0, c));
+}
+
+static Direction3 rotateTowards(const Direction3& a, const Direction3& b, double angle) {
+    Direction3 k = cross(a, b);
+    double len = k.length();
+    if (len < 1e-12) return a;
+    k = k * (1.0 / len);
+    return (a * cos(angle) + cross(k, a) * sin(angle)).normalized();
+}
+
+// Smallest cone containing cones (a_axis, a_o) and (b_axis, b_o)
+static void mergeCones(Direction3 a_axis, double a_o,
+                       Direction3 b_axis, double b_o,
+                       Direction3& axis, double& theta_o) {
+    if (b_o > a_o) {
+        std::swap(a_axis, b_axis);
+        std::swap(a_o, b_o);
+    }
+
+    double theta_d = acos(clampCos(dot(a_axis, b_axis)));
+    if (std::min(theta_d + b_o, M_PI) <= a_o) {
+        axis = a_axis;
+        theta_o = a_o;
+        return;
+    }
+
+    theta_o = (a_o + theta_d + b_o) / 2.0;
+    if (theta_o >= M_PI || cross(a_axis, b_axis).length() < 1e-12) {
+        axis = a_axis;
+        theta_o = M_PI;
+        return;
+    }
+
+    axis = rotateTowards(a_axis, b_axis, theta_o - a_o);
+}
+
+static void setReach(LightTreeNode& node) {
+    double reach = node.theta_o + node.theta_e;
+    node.cone_limited = reach < M_PI;
+    node.cos_reach = node.cone_limited ? cos(reach) : -1.0;
+}
+
+static void setLeaf(LightTreeNode& node, const LightItem& item) {
+    const LightBounds& b = item.first;
+    node.bmin    = b.position;
+    node.bmax    = b.position;
+    node.axis    = b.axis;
+    node.theta_o = b.theta_o;
+    node.theta_e = b.theta_e;
+    node.power   = b.power;
+    node.light   = item.second;
+    setReach(node);
+}
+
+static void setInterior(LightTreeNode& node, const LightTreeNode& l, const LightTreeNode& r) {
+    node.bmin = Point3(std::min(l.bmin.x, r.bmin.x),
+                       std::min(l.bmin.y, r.bmin.y),
+                       std::min(l.bmin.z, r.bmin.z));
+    node.bmax = Point3(std::max(l.bmax.x, r.bmax.x),
+                       std::max(l.bmax.y, r.bmax.y),
+                       std::max(l.bmax.z, r.bmax.z));
+    mergeCones(l.axis, l.theta_o, r.axis, r.theta_o, node.axis, node.theta_o);
+    node.theta_e = std::max(l.theta_e, r.theta_e);
+    node.power   = l.power + r.power;
+    setReach(node);
+}
+
+// Median split on the widest axis of the light positions
+static int buildNode(std::vector<LightTreeNode>& nodes,
+                     std::vector<LightItem>& items, int begin, int end) {
+    int index = static_cast<int>(nodes.size());
+    nodes.emplace_back();
+
+    if (end - begin == 1) {
+        setLeaf(nodes[index], items[begin]);
+        return index;
+    }
+
+    Point3 lo = items[begin].first.position;
+    Point3 hi = lo;
+    for (int i = begin + 1; i < end; ++i) {
+        const Point3& q = items[i].first.position;
+        lo = Point3(std::min(lo.x, q.x), std::min(lo.y, q.y), std::min(lo.z, q.z));
+        hi = Point3(std::max(hi.x, q.x), std::max(hi.y, q.y), std::max(hi.z, q.z));
+    }
+    Direction3 ext = hi - lo;
+    int axis = (ext.x >= ext.y && ext.x >= ext.z) ? 0 : (ext.y >= ext.z ? 1 : 2);
+
+    int mid = begin + (end - begin) / 2;
+    std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+                     [axis](const LightItem& a, const LightItem& b) {
+                         const Point3& pa = a.first.position;
+                         const Point3& pb = b.first.position;
+                         return axis == 0 ? pa.x < pb.x
+                              : axis == 1 ? pa.y < pb.y
+                                          : pa.z < pb.z;
+                     });
+
+    int left  = buildNode(nodes, items, begin, mid);
+    int right = buildNode(nodes, items, mid, end);
+
+    nodes[index].left  = left;
+    nodes[index].right = right;
+    setInterior(nodes[index], nodes[left], nodes[right]);
+    return index;
+}
+
+void LightTree::build(const std::vector<Light*>& lights) {
+    nodes.clear();
+    infinite.clear();
+
+    std::vector<LightItem> items;
+    for (const Light* light : lights) {
+        LightBounds b;
+        if (light->getBounds(b)) items.emplace_back(b, light);
+        else                     infinite.push_back(light);
+    }
+
+    if (items.empty()) return;
+
+    nodes.reserve(2 * items.size() - 1);
+    buildNode(nodes, items, 0, static_cast<int>(items.size()));
+}
+
+// Angular terms shared by bound() and importance(): whether the emission
+// cone can face p, and the largest cosine between N and any direction to
+// the node. Returns false if either is zero. Angles are compared through
+// their cosines/sines so no trigonometric calls are needed per node.
+static bool angularTerms(const LightTreeNode& node, const Point3& p,
+                         const Direction3& N, bool cosine,
+                         double& d2center, double& r2, double& cosFactor) {
+    Point3 c = 0.5 * (node.bmin + node.bmax);
+    Direction3 toP = p - c;
+    d2center = length_squared(toP);
+    r2 = 0.25 * length_squared(node.bmax - node.bmin);
+    cosFactor = 1.0;
+
+    // p inside the bounding sphere: any direction is possible
+    if (d2center <= r2) return true;
+
+    double d = sqrt(d2center);
+    Direction3 dir = toP * (1.0 / d);
+
+    // theta_u: half-angle subtended by the node's bounding sphere
+    double sin_u = sqrt(r2 / d2center);
+    double cos_u = sqrt(1.0 - r2 / d2center);
+
+    // reachable iff angle(axis, dir) <= theta_o + theta_e + theta_u
+    if (node.cone_limited) {
+        double cos_t = dot(node.axis, dir);
+        double sin_t = sqrt(std::max(0.0, 1.0 - cos_t * cos_t));
+        // cos(angle - theta_u), i.e. the angle reduced by theta_u
+        double cos_reduced = (cos_t >= cos_u) ? 1.0 : cos_t * cos_u + sin_t * sin_u;
+        if (cos_reduced < node.cos_reach - ANGLE_SLACK) return false;
+    }
+
+    if (cosine) {
+        double cos_i = -dot(N, dir);
+        double sin_i = sqrt(std::max(0.0, 1.0 - cos_i * cos_i));
+        double cos_reduced = (cos_i >= cos_u) ? 1.0 : cos_i * cos_u + sin_i * sin_u;
+        if (cos_reduced < -ANGLE_SLACK) return false;
+        cosFactor = std::max(0.0, cos_reduced);
+    }
+
+    return true;
+}
+
+double LightTree::bound(const LightTreeNode& node, const Point3& p,
+                        const Direction3& N, bool cosine) const {
+    double d2center, r2, cosFactor;
+    if (!angularTerms(node, p, N, cosine, d2center, r2, cosFactor)) return 0.0;
+
+    // closest distance from p to the node's box
+    double dx = std::max(0.0, std::max(node.bmin.x - p.x, p.x - node.bmax.x));
+    double dy = std::max(0.0, std::max(node.bmin.y - p.y, p.y - node.bmax.y));
+    double dz = std::max(0.0, std::max(node.bmin.z - p.z, p.z - node.bmax.z));
+    double d2 = dx * dx + dy * dy + dz * dz;
+    if (d2 <= 0.0) return std::numeric_limits<double>::infinity();
+
+    // cosFactor may round to 0 at grazing angles; keep the bound positive
+    return node.power * std::max(cosFactor, ANGLE_SLACK) / d2;
+}
+
+double LightTree::importance(const LightTreeNode& node, const Point3& p,
+                             const Direction3& N, bool cosine) const {
+    double d2center, r2, cosFactor;
+    if (!angularTerms(node, p, N, cosine, d2center, r2, cosFactor)) return 0.0;
+
+    double d2 = std::max(std::max(d2center, r2), 1e-12);
+    return node.power * std::max(cosFactor, ANGLE_SLACK) / d2;
+}
+
+const Light* LightTree::sample(const Point3& p, const Direction3& N, bool cosine,
+                               double u, double& pdf) const {
+    pdf = 1.0;
+    if (nodes.empty()) return nullptr;
+
+    int index = 0;
+    if (nodes[0].light && importance(nodes[0], p, N, cosine) <= 0.0) return nullptr;
+
+    while (!nodes[index].light) {
+        const LightTreeNode& node = nodes[index];
+        STAT_INC(light_tree_nodes);
+        double il = importance(nodes[node.left],  p, N, cosine);
+        double ir = importance(nodes[node.right], p, N, cosine);
+        if (il + ir <= 0.0) return nullptr;
+
+        double pl = il / (il + ir);
+        if (u < pl) {
+            index = node.left;
+            pdf *= pl;
+            u = u / pl;
+        } else {
+            index = node.right;
+            pdf *= 1.0 - pl;
+            u = (u - pl) / (1.0 - pl);
+        }
+        u = std::min(u, 1.0 - 1e-12);
+    }
+
+    return nodes[index].light;
+}
@@ -1,157 +1,383 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <cstring>
 #include "Include/scene.h"
 #include "Include/intersect.h"
 #include "Include/lighting.h"
+#include "Include/perfCounters.h"
 #include "Include/rayTrace.h"
+#include "Include/stats.h"
 
 static constexpr double EPS = 1e-4;
 
-Color DirectionalLight::getContribution(
-    const Scene& scene,
-    const Ray& ray,
-    HitInfo& hit)
+bool DirectionalLight::illuminate(
+    const Point3& p,
+    Direction3& L,
+    double& distance,
+    Color& radiance) const
 {
-    Color final_color(0, 0, 0);
-
-    Direction3 N = hit.normal.normalized();
-    Direction3 L = (-direction).normalized();   // surface → light
-    Direction3 V = (-ray.dir).normalized();     // surface → camera
+    (void)p;
+    L        = (-direction).normalized();   // surface → light
+    distance = std::numeric_limits<double>::infinity();
+    radiance = color;
+    return true;
+}
 
-    Point3 p = hit.point + N * EPS;
+bool Light::occluded(
+    const Scene& scene,
+    const Ray& shadowRay,
+    double distance,
+    int& occluder) const
+{
+    return FindOcclusion(scene, shadowRay, distance, occluder);
+}
 
-    Ray shadowRay(p, L);
-    HitInfo shadowHit;
+void DirectionalLight::prepare(const Scene& scene) {
+    occluders.build(scene, (-direction).normalized());
+}
 
-    if (!FindIntersection(scene, shadowRay, shadowHit)) {
-        // Diffuse
-        double NdotL = std::max(0.0, dot(N, L));
-        final_color += hit.material->diffuse * color * NdotL;
+bool DirectionalLight::occluded(
+    const Scene& scene,
+    const Ray& shadowRay,
+    double distance,
+    int& occluder) const
+{
+    if (occluders.empty()) return FindOcclusion(scene, shadowRay, distance, occluder);
+    return occluders.occluded(scene, shadowRay, distance, occluder);
+}
 
-        // Specular (Blinn–Phong)
-        Direction3 H = (V + L).normalized();
-        double NdotH = std::max(0.0, dot(N, H));
-        final_color += hit.material->specular * color *
-                       pow(NdotH, hit.material->ns);
-    }
+// Last primitive that blocked each light (by Light::id), -1 if none.
+// Neighbouring hit points are usually shadowed by the same primitive, so
+// it is tested before a full occlusion query.
+static thread_local std::vector<int> t_lastOccluder;
 
-    return final_color;
+void ResetShadowCache(const Scene& scene) {
+    t_lastOccluder.assign(scene.lights.size(), -1);
 }
 
-Color PointLight::getContribution(
+static bool Shadowed(
     const Scene& scene,
-    const Ray& ray,
-    HitInfo& hit)
+    const Light& light,
+    const Ray& shadowRay,
+    double distance)
 {
-    Color final_color(0, 0, 0);
+    KernelScope kernel(Kernel::Occlusion);
+    if (t_lastOccluder.size() != scene.lights.size()) ResetShadowCache(scene);
+    int& last = t_lastOccluder[light.id];
+
+    if (last >= 0) {
+        STAT_INC(shadow_cache_probes);
+        double t = intersectPrimitive(scene, shadowRay, last);
+        if (t > 0.0001 && t < distance) {
+            STAT_INC(shadow_cache_hits);
+            return true;
+        }
+    }
 
-    Direction3 N = hit.normal.normalized();
-    Direction3 V = (-ray.dir).normalized();
+    int occluder = -1;
+    if (light.occluded(scene, shadowRay, distance, occluder)) {
+        last = occluder;
+        return true;
+    }
+    return false;
+}
 
-    Point3 p = hit.point + N * EPS;
+bool PointLight::illuminate(
+    const Point3& p,
+    Direction3& L,
+    double& distance,
+    Color& radiance) const
+{
+    Direction3 toLight = position - p;
+    distance = toLight.length();
+    L        = toLight.normalized();        // surface → light
+    radiance = color / (distance * distance);
+    return true;
+}
 
+bool SpotLight::illuminate(
+    const Point3& p,
+    Direction3& L,
+    double& distance,
+    Color& radiance) const
+{
     Direction3 toLight = position - p;
-	double light_distance = toLight.length();
-    Direction3 L = toLight.normalized();    // surface → light
+    distance = toLight.length();
+    L        = toLight.normalized();
 
-    Ray shadowRay(p, L);
-    HitInfo shadowHit;
+    // Angle between spotlight direction and hit direction
+    double hitAngle =
+        acos(dot((-toLight).normalized(), direction.normalized())) * 180.0 / M_PI;
 
-    if (!(FindIntersection(scene, shadowRay, shadowHit) &&
-          shadowHit.distance < light_distance)) {
+    if (hitAngle > angle2)
+        return false;
 
-        Color attenuated_color = color / (light_distance * light_distance);
+    double falloff = 1.0;
+    if (hitAngle > angle1) {
+        double t = (hitAngle - angle1) / (angle2 - angle1);
+        falloff = std::max(0.0, 1.0 - t);
+    }
 
-        // Diffuse
-        double NdotL = std::max(0.0, dot(N, L));
-        final_color += hit.material->diffuse * attenuated_color * NdotL;
+    radiance = (color / (distance * distance)) * falloff;
+    return true;
+}
 
-        // Specular
-        Direction3 H = (L + V).normalized();
-        double NdotH = std::max(0.0, dot(N, H));
-        final_color += hit.material->specular * attenuated_color *
-                       pow(NdotH, hit.material->ns);
-    }
+static inline double maxComponent(const Color& c) {
+    return std::max(std::fabs(c.r), std::max(std::fabs(c.g), std::fabs(c.b)));
+}
 
-    return final_color;
+bool PointLight::getBounds(LightBounds& b) const {
+    b.position = position;
+    b.axis     = Direction3(0, 0, 1);
+    b.theta_o  = M_PI;
+    b.theta_e  = M_PI / 2;
+    b.power    = std::max(color.r, std::max(color.g, color.b));
+    return true;
 }
 
-Color SpotLight::getContribution(
+bool SpotLight::getBounds(LightBounds& b) const {
+    b.position = position;
+    b.axis     = direction.normalized();
+    b.theta_o  = 0.0;
+    b.theta_e  = std::min(angle2, 180.0) * M_PI / 180.0;
+    b.power    = std::max(color.r, std::max(color.g, color.b));
+    return true;
+}
+
+// Shadowed Blinn–Phong term of one light. The material class K is a
+// compile-time constant so the specular lobe is only built in when the
+// material can have one.
+//
+// Lights are rejected before the shadow ray whenever the unshadowed result
+// would already be zero or below scene.light_cutoff: outside a spot cone,
+// facing away from the surface, or too dim after attenuation.
+template <MaterialClass K>
+static Color ShadeLight(
     const Scene& scene,
+    const Light& light,
     const Ray& ray,
     HitInfo& hit)
 {
+    KernelScope kernel(Kernel::Shade);
     Color final_color(0, 0, 0);
+    const Material* m = hit.material;
+    STAT_INC(light_evals);
 
     Direction3 N = hit.normal.normalized();
-    Direction3 V = (-ray.dir).normalized();
-
     Point3 p = hit.point + N * EPS;
 
-    Direction3 toLight = position - p;
-    double light_distance = toLight.length();
-    Direction3 L = toLight.normalized();
-
-    Ray shadowRay(p, L);
-    HitInfo shadowHit;
-
-    if (FindIntersection(scene, shadowRay, shadowHit) &&
-        shadowHit.distance < light_distance)
+    Direction3 L;   // surface → light
+    double light_distance;
+    Color radiance;
+    if (!light.illuminate(p, L, light_distance, radiance)) {
+        STAT_INC(shadow_culled_cone);
         return final_color;
+    }
 
-    // Angle between spotlight direction and hit direction
-    double hitAngle =
-        acos(dot((-toLight).normalized(), direction.normalized())) * 180.0 / M_PI;
+    double NdotL = std::max(0.0, dot(N, L));
+    double NdotH = 0.0;
+    if constexpr (K != MaterialClass::Diffuse) {
+        Direction3 V = (-ray.dir).normalized();   // surface → camera
+        Direction3 H = (L + V).normalized();
+        NdotH = std::max(0.0, dot(N, H));
+    }
 
-    if (hitAngle > angle2)
+    // Back-facing: neither lobe can contribute (pow(0, 0) is 1, hence ns)
+    bool no_specular = (K == MaterialClass::Diffuse) ||
+                       (NdotH <= 0.0 && m->ns > 0.0);
+    if (NdotL <= 0.0 && no_specular) {
+        STAT_INC(shadow_culled_backface);
         return final_color;
+    }
 
-    double falloff = 1.0;
-    if (hitAngle > angle1) {
-        double t = (hitAngle - angle1) / (angle2 - angle1);
-        falloff = std::max(0.0, 1.0 - t);
+    // Upper bound of the unshadowed contribution
+    double bound = maxComponent(m->diffuse * radiance);
+    if constexpr (K != MaterialClass::Diffuse)
+        bound += maxComponent(m->specular * radiance);
+    if (bound <= scene.light_cutoff) {
+        STAT_INC(shadow_culled_cutoff);
+        return final_color;
     }
 
-    Color attenuated_color =
-        (color / (light_distance * light_distance)) * falloff;
+    STAT_INC(shadow_rays);
+    Ray shadowRay(p, L);
+
+    if (Shadowed(scene, light, shadowRay, light_distance)) {
+        STAT_INC(shadow_occluded);
+        return final_color;
+    }
 
     // Diffuse
-    double NdotL = std::max(0.0, dot(N, L));
-    final_color += hit.material->diffuse * attenuated_color * NdotL;
+    final_color += m->diffuse * radiance * NdotL;
 
     // Specular
-    Direction3 H = (L + V).normalized();
-    double NdotH = std::max(0.0, dot(N, H));
-    final_color += hit.material->specular * attenuated_color *
-                   pow(NdotH, hit.material->ns);
+    if constexpr (K != MaterialClass::Diffuse) {
+        final_color += m->specular * radiance * pow(NdotH, m->ns);
+    }
 
     return final_color;
 }
 
-Color ApplyLighting(
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+// Stateless uniform number in [0,1) from a shading point and a sample
+// index, so sampled images do not depend on how rows are split over ranks
+static double hashToUnit(const Point3& p, uint64_t sample) {
+    uint64_t h = mix64(sample + 0x9e3779b97f4a7c15ull);
+    for (double c : {p.x, p.y, p.z}) {
+        uint64_t bits;
+        std::memcpy(&bits, &c, sizeof(bits));
+        h = mix64(h ^ bits);
+    }
+    return static_cast<double>(h >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Sum of all light contributions at a hit. A given light list (a screen
+// tile's) or the light grid cell of the hit is shaded in scene order.
+// Without either, and without a light tree, every light is shaded. With a
+// tree, directional lights are always shaded and point/spot lights are
+// either culled by subtree bounds or, with light_samples > 0, picked by
+// importance and weighted by 1/pdf.
+template <MaterialClass K>
+static Color DirectLight(
+    const Scene& scene,
+    const Ray& ray,
+    HitInfo& hit,
+    const std::vector<const Light*>* lights)
+{
+    Color color(0, 0, 0);
+    const LightTree& tree = scene.lightTree;
+
+    if (lights) {
+        for (const Light* light : *lights) {
+            color += ShadeLight<K>(scene, *light, ray, hit);
+        }
+        return color;
+    }
+
+    const Light* const* cell_begin;
+    const Light* const* cell_end;
+    if (!scene.lightGrid.empty() &&
+        scene.lightGrid.cellLightsAt(hit.point, cell_begin, cell_end)) {
+        for (const Light* const* l = cell_begin; l != cell_end; ++l) {
+            color += ShadeLight<K>(scene, **l, ray, hit);
+        }
+        return color;
+    }
+
+    if (tree.empty()) {
+        for (Light* light : scene.lights) {
+            color += ShadeLight<K>(scene, *light, ray, hit);
+        }
+        return color;
+    }
+
+    for (const Light* light : tree.infinite) {
+        color += ShadeLight<K>(scene, *light, ray, hit);
+    }
+
+    Direction3 N = hit.normal.normalized();
+    Point3 p = hit.point + N * EPS;
+    constexpr bool cosine = (K == MaterialClass::Diffuse);
+
+    if (scene.light_samples > 0) {
+        Color sum(0, 0, 0);
+        for (int s = 0; s < scene.light_samples; ++s) {
+            double pdf;
+            const Light* light = tree.sample(p, N, cosine, hashToUnit(p, s), pdf);
+            if (light) sum += ShadeLight<K>(scene, *light, ray, hit) / pdf;
+        }
+        color += sum / scene.light_samples;
+    } else {
+        double reflectance = maxComponent(hit.material->diffuse);
+        if constexpr (K != MaterialClass::Diffuse)
+            reflectance += maxComponent(hit.material->specular);
+
+        tree.forEachLight(p, N, cosine, reflectance, scene.light_cutoff,
+                          [&](const Light& light) {
+                              color += ShadeLight<K>(scene, light, ray, hit);
+                          });
+    }
+
+    return color;
+}
+
+// Full shading of a hit for material class K: ambient, direct light and,
+// for classes that have them, the reflection and refraction rays.
+template <MaterialClass K>
+static Color ShadeHit(
     const Scene& scene,
     Ray& ray,
     HitInfo& hit,
-    int depth)
+    int depth,
+    const std::vector<const Light*>* lights)
 {
     Color color = hit.material->ambient * scene.ambient_light;
 
-    for (Light* light : scene.lights) {
-        color += light->getContribution(scene, ray, hit);
+    color += DirectLight<K>(scene, ray, hit, lights);
+
+    if constexpr (K != MaterialClass::Diffuse) {
+        if (depth > 0) {
+            // Refraction
+            if constexpr (K == MaterialClass::Transmissive) {
+                STAT_INC(refraction_rays);
+                Ray refraction = Refract(ray, hit);
+                color += hit.material->trans *
+                         rayTrace(refraction, depth - 1, scene);
+            }
+
+            // Reflection
+            STAT_INC(reflection_rays);
+            Ray reflection = Reflect(ray, hit);
+            color += hit.material->specular *
+                     rayTrace(reflection, depth - 1, scene);
+        } else {
+            STAT_INC(depth_limited);
+        }
     }
 
-    if (depth > 0) {
-        // Refraction
-        Ray refraction = Refract(ray, hit);
-        color += hit.material->trans *
-                 rayTrace(refraction, depth - 1, scene);
+    return color;
+}
 
-        // Reflection
-        Ray reflection = Reflect(ray, hit);
-        color += hit.material->specular *
-                 rayTrace(reflection, depth - 1, scene);
+Color Light::getContribution(
+    const Scene& scene,
+    const Ray& ray,
+    HitInfo& hit) const
+{
+    switch (hit.material->shading) {
+        case MaterialClass::Diffuse:
+            return ShadeLight<MaterialClass::Diffuse>(scene, *this, ray, hit);
+        case MaterialClass::Specular:
+            return ShadeLight<MaterialClass::Specular>(scene, *this, ray, hit);
+        default:
+            return ShadeLight<MaterialClass::Transmissive>(scene, *this, ray, hit);
     }
+}
 
-    return color;
+Color ApplyLighting(
+    const Scene& scene,
+    Ray& ray,
+    HitInfo& hit,
+    int depth,
+    const std::vector<const Light*>* lights)
+{
+    MaterialClass shading = hit.material->shading;
+    STAT_INC(shade_hits[static_cast<int>(shading)]);
+
+    switch (shading) {
+        case MaterialClass::Diffuse:
+            return ShadeHit<MaterialClass::Diffuse>(scene, ray, hit, depth, lights);
+        case MaterialClass::Specular:
+            return ShadeHit<MaterialClass::Specular>(scene, ray, hit, depth, lights);
+        default:
+            return ShadeHit<MaterialClass::Transmissive>(scene, ray, hit, depth, lights);
+    }
 }
@@ -7,13 +7,22 @@
 // MPI
 #include <mpi.h>
 
-// Image and ray tracer includes
+// Ray tracer includes; the stb implementations come in through types.h
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "Include/Image/image_lib.h"
-#include "Include/ray.h"
-#include "Include/rayTrace.h"
+#include "Include/aov.h"
+#include "Include/framebuffer.h"
+#include "Include/gather.h"
+#include "Include/imageStream.h"
+#include "Include/memoryReport.h"
+#include "Include/mpiioWriter.h"
+#include "Include/perfCounters.h"
+#include "Include/render.h"
 #include "Include/scene.h"
+#include "Include/stats.h"
+#include "Include/streamRender.h"
+#include "Include/tiledImage.h"
+#include "Include/timing.h"
 
 #include <iostream>
 #include <string>
@@ -21,135 +30,358 @@
 #include <iomanip>
 #include <algorithm>
 #include <vector>
+#include <memory>
+#include <cstdlib>
+
+// How the rendered rows reach the output file
+enum class OutputMode {
+    Gather,   // row chunks sent to rank 0 during tracing; rank 0 encodes the whole image
+    Stream,   // bands sent to rank 0 and written as they complete
+    MPIIO,    // every rank writes its own rows into the file (ppm, pfm)
+    Tiled     // tile rows written into a .tiles file as they are traced
+};
+
+// Barrier charged to the wait phase
+static void WaitForAllRanks() {
+    PhaseScope wait(Phase::Wait, "barrier");
+    MPI_Barrier(MPI_COMM_WORLD);
+}
 
-int main(int argc, char** argv) {
-    MPI_Init(&argc, &argv);
+// Framebuffers for the AOVs the scene enables, rows x width each
+struct AovTargets {
+    std::unique_ptr<Framebuffer> storage[AOV_COUNT];
+    AovBuffers buffers;
 
-    int world_size = 0;
-    int world_rank = 0;
-    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
-    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
-
-    // Only rank 0 prints usage info
-    if (argc < 2) {
-        if (world_rank == 0) {
-            std::cout << "Usage: mpirun -np <procs> ray_mpi <scenefile>\n";
+    AovTargets(unsigned enabled, int width, int rows) {
+        for (int a = 0; a < AOV_COUNT; ++a) {
+            if (!(enabled & (1u << a))) continue;
+            storage[a].reset(new Framebuffer(width, rows, AovFormat(static_cast<Aov>(a))));
+            buffers.fb[a] = storage[a].get();
         }
-        MPI_Finalize();
-        return 0;
     }
+};
 
-    std::string sceneFileName = argv[1];
-    int img_width, img_height;
-    std::string imgName;
+// Trace this rank's contiguous block of rows chunk by chunk, sending each
+// chunk towards rank 0 (through the node leader unless flat) while the
+// next one is traced, and write the image there
+static void RenderGathered(RenderContext& ctx, const std::string& imgName,
+                           bool compress, bool compress_node, bool flat, int world_rank) {
+    int img_width  = ctx.width;
+    int img_height = ctx.height;
 
-    // All ranks read the same scene file
-    Scene scene = parseSceneFile(sceneFileName, img_width, img_height, imgName);
+    // Rows are split in node-major rank order (rank 0 stays first)
+    NodeGather gather(MPI_COMM_WORLD, flat);
+    int gather_rank = gather.rank();
+    int gather_size = gather.size();
 
-    // Each rank owns a full image buffer; only rank 0 will write it out
-    Image outputImg(img_width, img_height);
+    // Split rows across ranks (almost equal, first few ranks get +1)
+    int base_rows = img_height / gather_size;
+    int remainder = img_height % gather_size;
 
-    // Basic camera parameters
-    float imgW   = static_cast<float>(img_width);
-    float imgH   = static_cast<float>(img_height);
-    float halfW  = imgW / 2.0f;
-    float halfH  = imgH / 2.0f;
-    float d      = halfH / tanf(scene.camera_fov_ha * (M_PI / 180.0f));
+    int local_rows = base_rows + (gather_rank < remainder ? 1 : 0);
+    int start_row  = gather_rank * base_rows + std::min(gather_rank, remainder);
 
-    // Point on the view plane at distance d from the camera
-    Point3 cam_origin = scene.camera_pos - d * scene.camera_fwd;
+    // Build recvcounts and offsets (in rows) for the gather
+    std::vector<int> recvcounts(gather_size);
+    std::vector<int> displs(gather_size);
 
-    // One-pixel step along the x direction
-    Direction3 step_x = -scene.camera_right;
+    for (int r = 0; r < gather_size; ++r) {
+        int rows_r     = base_rows + (r < remainder ? 1 : 0);
+        recvcounts[r]  = rows_r;
 
-    // Split rows across ranks (almost equal, first few ranks get +1)
-    int base_rows = img_height / world_size;
-    int remainder = img_height % world_size;
+        int start_r    = r * base_rows + std::min(r, remainder);
+        displs[r]      = start_r;
+    }
 
-    int local_rows = base_rows + (world_rank < remainder ? 1 : 0);
-    int start_row  = world_rank * base_rows + std::min(world_rank, remainder);
+    // Rank 0 holds the whole image and node leaders their node's rows. Both
+    // shade their own rows (which come first) in place; every other rank
+    // only holds its rows.
+    int fb_rows = gather.bufferRows(recvcounts);
+    Framebuffer fb(img_width, fb_rows, PixelFormatFor(imgName));
+    AovTargets aovs(ctx.scene.aovs, img_width, fb_rows);
 
-    // Each pixel is stored as 3 floats (RGB)
-    int sendcount = local_rows * img_width * 3;
-    std::vector<float> local_pixels(sendcount);
+    std::vector<Framebuffer*> layers = { &fb };
+    for (Framebuffer* a : aovs.buffers.fb) {
+        if (a) layers.push_back(a);
+    }
+    gather.start(layers, recvcounts, displs, compress, compress_node);
 
-    MPI_Barrier(MPI_COMM_WORLD);
+    WaitForAllRanks();
     double t0 = MPI_Wtime();
 
     // Ray trace the rows owned by this rank
-    for (int lr = 0; lr < local_rows; ++lr) {
-        int j = start_row + lr;  // global row index
-        float v = halfH - static_cast<float>(j) + 0.5f;
+    for (int r = 0; r < local_rows; r += GATHER_CHUNK_ROWS) {
+        int n = std::min(GATHER_CHUNK_ROWS, local_rows - r);
+        RenderRows(ctx, start_row + r, n, fb, r, &aovs.buffers);
+        gather.send(r, n);
+    }
+    double t1 = MPI_Wtime();
 
-        // Starting point on the view plane for column 0
-        Point3 row_start = cam_origin
-                         + v * scene.camera_up
-                         + (halfW + 0.5f) * scene.camera_right;
+    bool gathered;
+    {
+        PhaseScope phase(Phase::Gather, "gather finish");
+        gathered = gather.finish();
+    }
+    double t2 = MPI_Wtime();
+
+    // Rank 0 writes the final image
+    if (world_rank == 0 && gathered) {
+        PhaseScope phase(Phase::Write, "write image");
+        fb.write(imgName.c_str());
+        for (int a = 0; a < AOV_COUNT; ++a) {
+            Framebuffer* f = aovs.buffers.fb[a];
+            if (!f) continue;
+            Aov aov = static_cast<Aov>(a);
+            f->write(AovFileName(imgName, aov).c_str());
+            if (IsCostAov(aov)) WriteHeatmap(*f, AovFileName(imgName, aov, ".png"));
+        }
+    }
+    double t3 = MPI_Wtime();
+    WaitForAllRanks();
 
-        Point3 p = row_start;
+    // Max over all ranks of the trace and end-to-end times. Rank 0 finishes
+    // last, so the total covers the gather and the write.
+    double local_ms[2]  = { (t1 - t0) * 1000.0, (t3 - t0) * 1000.0 };
+    double global_ms[2] = { 0.0, 0.0 };
+    MPI_Reduce(local_ms, global_ms, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
 
-        for (int i = 0; i < img_width; ++i) {
-            Ray ray(scene.camera_pos, p - scene.camera_pos);
-            Color result = rayTrace(ray, scene.max_depth, scene);
+    uint64_t local_traffic[4] = { gather.node_traffic.raw_bytes, gather.node_traffic.sent_bytes,
+                                  gather.traffic.raw_bytes, gather.traffic.sent_bytes };
+    uint64_t total_traffic[4] = { 0, 0, 0, 0 };
+    MPI_Reduce(local_traffic, total_traffic, 4, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
 
-            int idx = (lr * img_width + i) * 3;
-            // Color uses r,g,b (double); store as float for MPI
-            local_pixels[idx + 0] = static_cast<float>(result.r);
-            local_pixels[idx + 1] = static_cast<float>(result.g);
-            local_pixels[idx + 2] = static_cast<float>(result.b);
+    if (world_rank == 0) {
+        // Gather time left on the critical path: from the slowest rank's
+        // last chunk until rank 0 holds every row
+        double gather_ms = std::max(0.0, (t2 - t0) * 1000.0 - global_ms[0]);
 
-            // Move to the next pixel in this row
-            p = p + step_x;
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "\n[TIMING][MPI] total: " << global_ms[1] << " ms (incl. gather and write)\n";
+        std::cout << "[TIMING][MPI] trace: " << global_ms[0] << " ms\n";
+        // Bytes sent of the raw row bytes, per level of the gather. Leaders
+        // only send to rank 0 when there is more than one node.
+        std::cout << "[TIMING][MPI] gather: " << gather_ms << " ms after tracing";
+        if (!flat) {
+            std::cout << ", " << total_traffic[1] / 1048576.0 << " of " << total_traffic[0] / 1048576.0
+                      << " MB sent to node leaders";
         }
+        if (flat || gather.nodes() > 1) {
+            std::cout << ", " << total_traffic[3] / 1048576.0 << " of " << total_traffic[2] / 1048576.0
+                      << " MB sent to rank 0" << (flat ? "" : " by node leaders");
+        }
+        std::cout << "\n";
+        std::cout << "[TIMING][MPI] write: " << (t3 - t2) * 1000.0 << " ms\n\n";
+        if (!gathered) std::cerr << "Cannot write image file: " << imgName << std::endl;
+    }
+}
+
+// Bands are traced round-robin and written by rank 0 as they arrive
+static void RenderStreamedTimed(RenderContext& ctx, const std::string& imgName,
+                                int world_rank) {
+    WaitForAllRanks();
+    double t0 = MPI_Wtime();
+
+    bool written;
+    {
+        PhaseScope phase(Phase::Gather);
+        written = RenderStreamed(ctx, imgName, MPI_COMM_WORLD);
     }
 
     double t1       = MPI_Wtime();
+    WaitForAllRanks();
     double local_ms = (t1 - t0) * 1000.0;
 
-    // Use the max over all ranks as the runtime for this scene
+    // Rank 0 finishes last: its time includes writing the image
     double global_ms = 0.0;
     MPI_Reduce(&local_ms, &global_ms, 1, MPI_DOUBLE,
                MPI_MAX, 0, MPI_COMM_WORLD);
 
-    // Build recvcounts and offsets for Gatherv
-    std::vector<int> recvcounts(world_size);
-    std::vector<int> displs(world_size);
+    if (world_rank == 0) {
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "\n[TIMING][MPI] total: " << global_ms << " ms (streamed, incl. write)\n\n";
+        if (!written) std::cerr << "Cannot write image file: " << imgName << std::endl;
+    }
+}
 
-    for (int r = 0; r < world_size; ++r) {
-        int rows_r     = base_rows + (r < remainder ? 1 : 0);
-        recvcounts[r]  = rows_r * img_width * 3;
+// Trace this rank's contiguous block of rows and write it directly into
+// the shared ppm/pfm with MPI-IO
+static void RenderDirect(RenderContext& ctx, const std::string& imgName,
+                         int world_rank, int world_size) {
+    // Split rows across ranks (almost equal, first few ranks get +1)
+    int base_rows = ctx.height / world_size;
+    int remainder = ctx.height % world_size;
 
-        int start_r    = r * base_rows + std::min(r, remainder);
-        displs[r]      = start_r * img_width * 3;
+    int local_rows = base_rows + (world_rank < remainder ? 1 : 0);
+    int start_row  = world_rank * base_rows + std::min(world_rank, remainder);
+
+    Framebuffer fb(ctx.width, local_rows, PixelFormatFor(imgName));
+    AovTargets aovs(ctx.scene.aovs, ctx.width, local_rows);
+
+    WaitForAllRanks();
+    double t0 = MPI_Wtime();
+
+    RenderRows(ctx, start_row, local_rows, fb, 0, &aovs.buffers);
+
+    double t1 = MPI_Wtime();
+    bool written;
+    {
+        PhaseScope phase(Phase::Write, "write mpiio");
+        written = WriteRasterMPIIO(imgName, fb, start_row, local_rows,
+                                   ctx.height, MPI_COMM_WORLD);
+        for (int a = 0; a < AOV_COUNT; ++a) {
+            if (!aovs.buffers.fb[a]) continue;
+            written = WriteRasterMPIIO(AovFileName(imgName, static_cast<Aov>(a)), *aovs.buffers.fb[a],
+                                       start_row, local_rows, ctx.height, MPI_COMM_WORLD) && written;
+        }
     }
+    double t2 = MPI_Wtime();
+    WaitForAllRanks();
+
+    // Max over all ranks of the trace, write and end-to-end times
+    double local_ms[3] = { (t1 - t0) * 1000.0, (t2 - t1) * 1000.0, (t2 - t0) * 1000.0 };
+    double global_ms[3] = { 0.0, 0.0, 0.0 };
+    MPI_Reduce(local_ms, global_ms, 3, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
 
-    std::vector<float> all_pixels;
     if (world_rank == 0) {
-        all_pixels.resize(img_width * img_height * 3);
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "\n[TIMING][MPI] total: " << global_ms[2] << " ms (MPI-IO, incl. write)\n";
+        std::cout << "[TIMING][MPI] trace: " << global_ms[0] << " ms\n";
+        std::cout << "[TIMING][MPI] write (MPI-IO): " << global_ms[1] << " ms\n\n";
+        if (!written) std::cerr << "Cannot write image file: " << imgName << std::endl;
     }
+}
+
+// Tile rows are traced and written into the .tiles file by their ranks
+static void RenderTiledTimed(RenderContext& ctx, const std::string& imgName,
+                             int preview_size, int world_rank) {
+    WaitForAllRanks();
+    double t0 = MPI_Wtime();
+
+    bool written = RenderTiled(ctx, imgName, preview_size, MPI_COMM_WORLD);
 
-    // Gather all partial images to rank 0
-    MPI_Gatherv(local_pixels.data(), sendcount, MPI_FLOAT,
-                world_rank == 0 ? all_pixels.data() : nullptr,
-                recvcounts.data(), displs.data(), MPI_FLOAT,
-                0, MPI_COMM_WORLD);
+    double t1       = MPI_Wtime();
+    WaitForAllRanks();
+    double local_ms = (t1 - t0) * 1000.0;
+
+    double global_ms = 0.0;
+    MPI_Reduce(&local_ms, &global_ms, 1, MPI_DOUBLE,
+               MPI_MAX, 0, MPI_COMM_WORLD);
 
-    // Rank 0 writes the final image and timing
     if (world_rank == 0) {
-        for (int j = 0; j < img_height; ++j) {
-            for (int i = 0; i < img_width; ++i) {
-                int idx = (j * img_width + i) * 3;
-                Color &pixel = outputImg.getPixel(i, j);
-                pixel.r = all_pixels[idx + 0];
-                pixel.g = all_pixels[idx + 1];
-                pixel.b = all_pixels[idx + 2];
-            }
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "\n[TIMING][MPI] total: " << global_ms << " ms (tiled, incl. write)\n\n";
+        if (!written) std::cerr << "Cannot write image file: " << imgName << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    MPI_Init(&argc, &argv);
+
+    int world_size = 0;
+    int world_rank = 0;
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    StartPhaseTiming();
+
+    // Only rank 0 prints usage info
+    if (argc < 2) {
+        if (world_rank == 0) {
+            std::cout << "Usage: mpirun -np <procs> ray_mpi <scenefile> [options]\n"
+                      << "  --stream       write bands as they complete (ppm, pfm, png)\n"
+                      << "  --mpiio        every rank writes its own rows with MPI-IO (ppm, pfm)\n"
+                      << "  --preview <n>  with a .tiles output, also write a preview of at most n pixels\n"
+                      << "  --scratch <d>  directory for disk-backed framebuffers (default $TMPDIR)\n"
+                      << "  --no-compress  gather raw rows instead of run-length encoded ones\n"
+                      << "  --flat-gather  every rank sends its rows to rank 0, not via node leaders\n"
+                      << "  --node-rle     also run-length encode rows sent to node leaders\n"
+                      << "  --trace <f>    write a Chrome trace (JSON) of every rank's timeline to f\n"
+                      << "  --perf         count hardware events per phase and kernel (perf_event_open)\n";
         }
+        MPI_Finalize();
+        return 0;
+    }
 
-        std::cout << std::fixed << std::setprecision(3);
-        std::cout << "\n[TIMING][MPI] total: " << global_ms << " ms\n\n";
+    std::string sceneFileName = argv[1];
+    int img_width, img_height;
+    std::string imgName;
+
+    OutputMode output = OutputMode::Gather;
+    int preview_size = 0;
+    bool compress = true;
+    bool flat_gather = false;
+    bool compress_node = false;
+    std::string trace_file;
+    bool perf = false;
+    for (int a = 2; a < argc; ++a) {
+        std::string opt = argv[a];
+        if (opt == "--stream") {
+            output = OutputMode::Stream;
+        } else if (opt == "--mpiio") {
+            output = OutputMode::MPIIO;
+        } else if (opt == "--preview" && a + 1 < argc) {
+            preview_size = std::atoi(argv[++a]);
+        } else if (opt == "--no-compress") {
+            compress = false;
+        } else if (opt == "--flat-gather") {
+            flat_gather = true;
+        } else if (opt == "--node-rle") {
+            compress_node = true;
+        } else if (opt == "--trace" && a + 1 < argc) {
+            trace_file = argv[++a];
+        } else if (opt == "--perf") {
+            perf = true;
+        } else if (opt == "--scratch" && a + 1 < argc) {
+            SetFramebufferScratchDir(argv[++a]);
+        } else if (world_rank == 0) {
+            std::cerr << "Warning: unknown option " << opt << std::endl;
+        }
+    }
+
+    if (!trace_file.empty()) StartTrace();
+    if (perf) StartPerfCounters(world_rank);
+
+    // All ranks read the same scene file
+    Scene scene;
+    {
+        PhaseScope phase(Phase::Parse);
+        scene = parseSceneFile(sceneFileName, img_width, img_height, imgName);
+    }
+
+    RenderContext ctx(scene, img_width, img_height);
+
+    // .tiles files are only ever written tile row by tile row
+    if (IsTiledFormat(imgName)) output = OutputMode::Tiled;
+
+    if ((output == OutputMode::Stream && !ImageStreamSupported(imgName)) ||
+        (output == OutputMode::MPIIO && !IsRasterFormat(imgName))) {
+        if (world_rank == 0) {
+            std::cerr << "Warning: no " << (output == OutputMode::Stream ? "streaming" : "MPI-IO")
+                      << " writer for " << imgName << ", gathering the full image instead" << std::endl;
+        }
+        output = OutputMode::Gather;
+    }
+
+    // AOVs need every primary hit of a rank in one buffer
+    if (scene.aovs && (output == OutputMode::Stream || output == OutputMode::Tiled) && world_rank == 0) {
+        std::cerr << "Warning: aovs are only written by the gather and --mpiio outputs" << std::endl;
+    }
+
+    switch (output) {
+        case OutputMode::Stream: RenderStreamedTimed(ctx, imgName, world_rank);                   break;
+        case OutputMode::MPIIO:  RenderDirect(ctx, imgName, world_rank, world_size);              break;
+        case OutputMode::Gather:
+            RenderGathered(ctx, imgName, compress, compress_node, flat_gather, world_rank);
+            break;
+        case OutputMode::Tiled:  RenderTiledTimed(ctx, imgName, preview_size, world_rank);        break;
+    }
 
-        outputImg.write(imgName.c_str());
+    // Per-rank phase times, counters and memory over all ranks
+    ReportPhaseTiming(world_rank);
+    ReportStats(world_rank);
+    ReportPerfCounters(world_rank);
+    ReportMemory(ctx, world_rank);
+    if (!WriteTrace(trace_file, world_rank)) {
+        std::cerr << "Cannot write trace file: " << trace_file << std::endl;
     }
 
     // Clean up scene objects on each rank
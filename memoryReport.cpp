@@ -0,0 +1,177 @@
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+#include <mpi.h>
+#include <sys/resource.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include "Include/memoryReport.h"
+
+MemoryCounter g_framebuffer_memory;
+MemoryCounter g_mapped_framebuffer_memory;
+
+// Rows of the report, in order
+enum class MemoryUse {
+    Spheres,
+    Triangles,
+    Materials,
+    Lights,
+    Vertices,
+    Normals,
+    LightTree,
+    LightGrid,
+    ShadowGrids,      // light-space occluder grids of directional lights
+    RenderBuffers,    // per-band scratch of the light-grid tile path
+    Framebuffers,     // peak
+    Accounted,        // sum of the above
+    MappedFramebuffers,   // peak, backed by scratch files
+    HeapInUse,        // malloc's view, where the C library reports it
+    PeakRss,
+    Count
+};
+static constexpr int MEMORY_USE_COUNT = static_cast<int>(MemoryUse::Count);
+
+static const char* const MEMORY_USE_NAMES[MEMORY_USE_COUNT] = {
+    "spheres", "triangles", "materials", "lights", "vertices", "normals",
+    "light tree", "light grid", "shadow grids", "render buffers", "framebuffers",
+    "accounted", "mapped fbs", "heap in use", "peak RSS"
+};
+
+static const char* const MEMORY_USE_KEYS[MEMORY_USE_COUNT] = {
+    "spheres", "triangles", "materials", "lights", "vertices", "normals",
+    "light_tree", "light_grid", "shadow_grids", "render_buffers", "framebuffers",
+    "accounted", "mapped_framebuffers", "heap_in_use", "peak_rss"
+};
+
+template <class T>
+static uint64_t VectorBytes(const std::vector<T>& v) {
+    return static_cast<uint64_t>(v.capacity()) * sizeof(T);
+}
+
+static uint64_t LightBytes(const Light* light, uint64_t& shadow_grids) {
+    if (auto d = dynamic_cast<const DirectionalLight*>(light)) {
+        shadow_grids += VectorBytes(d->occluders.cellStart) + VectorBytes(d->occluders.items);
+        return sizeof(DirectionalLight);
+    }
+    if (dynamic_cast<const SpotLight*>(light)) return sizeof(SpotLight);
+    return sizeof(PointLight);
+}
+
+static uint64_t PeakRssBytes() {
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;   // kB
+#endif
+}
+
+static uint64_t HeapInUseBytes() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return static_cast<uint64_t>(info.uordblks) + info.hblkhd;   // arenas + mmapped blocks
+#else
+    return 0;
+#endif
+}
+
+void ReportMemory(const RenderContext& ctx, int world_rank) {
+    const Scene& scene = ctx.scene;
+    uint64_t local[MEMORY_USE_COUNT + 1] = {};
+    auto at = [&](MemoryUse u) -> uint64_t& { return local[static_cast<int>(u)]; };
+
+    at(MemoryUse::Spheres)   = scene.spheres.size() * sizeof(Sphere) + VectorBytes(scene.spheres);
+    at(MemoryUse::Triangles) = scene.triangles.size() * sizeof(Triangle) + VectorBytes(scene.triangles);
+    at(MemoryUse::Materials) = scene.materials.size() * sizeof(Material) + VectorBytes(scene.materials);
+    at(MemoryUse::Lights)    = VectorBytes(scene.lights);
+    for (const Light* light : scene.lights) {
+        at(MemoryUse::Lights) += LightBytes(light, at(MemoryUse::ShadowGrids));
+    }
+    at(MemoryUse::Vertices)  = VectorBytes(scene.vertices);
+    at(MemoryUse::Normals)   = VectorBytes(scene.normals);
+    at(MemoryUse::LightTree) = VectorBytes(scene.lightTree.nodes) + VectorBytes(scene.lightTree.infinite);
+
+    const LightGrid& grid = scene.lightGrid;
+    at(MemoryUse::LightGrid) = VectorBytes(grid.lights) + VectorBytes(grid.centers)
+                             + VectorBytes(grid.radius2) + VectorBytes(grid.cellStart)
+                             + VectorBytes(grid.cellLights);
+    at(MemoryUse::RenderBuffers) = VectorBytes(ctx.band_rays) + VectorBytes(ctx.band_hits)
+                                 + VectorBytes(ctx.band_found) + VectorBytes(ctx.tile_lights);
+    at(MemoryUse::Framebuffers) = g_framebuffer_memory.peak;
+    for (int u = 0; u < static_cast<int>(MemoryUse::Accounted); ++u) {
+        at(MemoryUse::Accounted) += local[u];
+    }
+    at(MemoryUse::MappedFramebuffers) = g_mapped_framebuffer_memory.peak;
+    at(MemoryUse::HeapInUse) = HeapInUseBytes();
+    at(MemoryUse::PeakRss)   = PeakRssBytes();
+
+    // Last column: the world rank leading this rank's node, as in NodeGather
+    MPI_Comm shared;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, world_rank, MPI_INFO_NULL, &shared);
+    int leader = world_rank;
+    MPI_Bcast(&leader, 1, MPI_INT, 0, shared);
+    MPI_Comm_free(&shared);
+    local[MEMORY_USE_COUNT] = static_cast<uint64_t>(leader);
+
+    int size = 1;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    constexpr int N = MEMORY_USE_COUNT + 1;
+    std::vector<uint64_t> all(world_rank == 0 ? static_cast<size_t>(N) * size : 0);
+    MPI_Gather(local, N, MPI_UINT64_T, all.data(), N, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    if (world_rank != 0) return;
+
+    auto value = [&](int rank, int u) { return all[static_cast<size_t>(rank) * N + u]; };
+    const double MB = 1024.0 * 1024.0;
+    const bool heap_known = HeapInUseBytes() > 0;
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "[MEMORY] component          min MB      mean MB       max MB  (rank)\n";
+    for (int u = 0; u < MEMORY_USE_COUNT; ++u) {
+        if (u == static_cast<int>(MemoryUse::HeapInUse) && !heap_known) continue;
+        uint64_t min = value(0, u), max = value(0, u);
+        int max_rank = 0;
+        double mean = 0.0;
+        for (int r = 0; r < size; ++r) {
+            uint64_t v = value(r, u);
+            min = std::min(min, v);
+            mean += v / MB / size;
+            if (v > max) { max = v; max_rank = r; }
+        }
+        std::cout << "[MEMORY] " << std::left << std::setw(14) << MEMORY_USE_NAMES[u] << std::right
+                  << std::setw(12) << min / MB << std::setw(13) << mean
+                  << std::setw(13) << max / MB << "  (" << max_rank << ")\n";
+    }
+
+    // Ranks of a node share its memory: the node that peaked highest is
+    // the one an out-of-memory kill hits first
+    std::map<uint64_t, std::pair<uint64_t, int>> nodes;   // leader -> RSS sum, ranks
+    for (int r = 0; r < size; ++r) {
+        auto& node = nodes[value(r, MEMORY_USE_COUNT)];
+        node.first += value(r, static_cast<int>(MemoryUse::PeakRss));
+        ++node.second;
+    }
+    auto top = nodes.begin();
+    for (auto it = nodes.begin(); it != nodes.end(); ++it) {
+        if (it->second.first > top->second.first) top = it;
+    }
+    std::cout << "[MEMORY] peak RSS summed per node: max " << top->second.first / MB
+              << " MB (" << top->second.second << " ranks, node of rank " << top->first
+              << "), " << nodes.size() << " node(s)\n";
+
+    // Per rank bytes on one line
+    std::ostringstream json;
+    json << "{\"ranks\":" << size << ",\"nodes\":" << nodes.size() << ",\"bytes\":{";
+    for (int u = 0; u < MEMORY_USE_COUNT; ++u) {
+        json << (u ? "," : "") << "\"" << MEMORY_USE_KEYS[u] << "\":[";
+        for (int r = 0; r < size; ++r) json << (r ? "," : "") << value(r, u);
+        json << "]";
+    }
+    json << "},\"node_leader\":[";
+    for (int r = 0; r < size; ++r) json << (r ? "," : "") << value(r, MEMORY_USE_COUNT);
+    json << "]}";
+    std::cout << "[MEMORY][JSON] " << json.str() << "\n";
+}
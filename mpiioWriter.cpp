@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <vector>
+#include "Include/mpiioWriter.h"
+#include "Include/imageStream.h"
+
+bool WriteRasterMPIIO(const std::string& fname, const Framebuffer& fb,
+                      int row0, int rows, int img_height, MPI_Comm comm) {
+    int rank = 0;
+    MPI_Comm_rank(comm, &rank);
+
+    const std::string header = RasterHeader(fname, fb.format, fb.width, img_height);
+    const size_t row_bytes = RasterRowBytes(fname, fb.format, fb.width);
+
+    // This rank's rows are one contiguous run of file rows (reversed for pfm)
+    int first = rows > 0 ? std::min(RasterFileRow(fname, row0, img_height),
+                                    RasterFileRow(fname, row0 + rows - 1, img_height))
+                         : 0;
+
+    // ppm rows are packed from RGBA8 into a staging block in file order. A
+    // pfm row is exactly a float framebuffer row, so pfm blocks are written
+    // from the framebuffer itself, last row first, without a copy
+    bool dump = fb.format != PixelFormat::RGBA8;
+    std::vector<uint8_t> packed(dump ? 0 : row_bytes * rows);
+    for (int y = 0; y < rows && !dump; ++y) {
+        int f = RasterFileRow(fname, row0 + y, img_height);
+        PackRasterRow(fname, fb.format, fb.row(y), fb.width,
+                      packed.data() + row_bytes * (f - first));
+    }
+
+    MPI_File fh;
+    int ok = MPI_File_open(comm, fname.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                           MPI_INFO_NULL, &fh) == MPI_SUCCESS;
+    if (!ok) return false;   // MPI_File_open is collective: all ranks fail
+
+    // Drop any longer file left from an earlier run
+    MPI_Offset size = static_cast<MPI_Offset>(header.size())
+                    + static_cast<MPI_Offset>(row_bytes) * img_height;
+    ok = MPI_File_set_size(fh, size) == MPI_SUCCESS;
+
+    if (rank == 0) {
+        ok = ok && MPI_File_write_at(fh, 0, header.data(), static_cast<int>(header.size()),
+                                     MPI_BYTE, MPI_STATUS_IGNORE) == MPI_SUCCESS;
+    }
+
+    // Count rows rather than bytes so large blocks fit in an int. The block
+    // steps forward through the staging rows, backwards through a pfm
+    // framebuffer.
+    MPI_Datatype row_type, block_type;
+    MPI_Type_contiguous(static_cast<int>(row_bytes), MPI_BYTE, &row_type);
+    MPI_Aint stride = static_cast<MPI_Aint>(row_bytes) * (dump ? -1 : 1);
+    MPI_Type_create_hvector(rows, 1, stride, row_type, &block_type);
+    MPI_Type_commit(&block_type);
+    const uint8_t* block = !dump ? packed.data() : rows > 0 ? fb.row(rows - 1) : fb.data;
+
+    MPI_Offset offset = static_cast<MPI_Offset>(header.size())
+                      + static_cast<MPI_Offset>(row_bytes) * first;
+    ok = MPI_File_write_at_all(fh, offset, block, 1, block_type,
+                               MPI_STATUS_IGNORE) == MPI_SUCCESS && ok;
+
+    MPI_Type_free(&block_type);
+    MPI_Type_free(&row_type);
+    ok = MPI_File_close(&fh) == MPI_SUCCESS && ok;
+
+    int all_ok = 0;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_LAND, comm);
+    return all_ok != 0;
+}
@@ -0,0 +1,386 @@
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Include/perfCounters.h"
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+bool g_perf_counting = false;
+Kernel g_perf_kernel = Kernel::Other;
+
+static bool g_perf_started = false;
+
+// Counts charged to one phase or kernel, and how many intervals they span
+struct PerfBucket {
+    uint64_t count[PERF_EVENT_COUNT] = {};
+    uint64_t intervals = 0;
+};
+
+static PerfBucket g_perf_phases[PHASE_COUNT];
+static PerfBucket g_perf_kernels[KERNEL_COUNT];
+static uint64_t g_perf_calls[KERNEL_COUNT] = {};
+
+static unsigned g_perf_available = 0;       // bit per PerfEvent
+static uint64_t g_perf_last[PERF_EVENT_COUNT] = {};
+static uint64_t g_perf_probe[PERF_EVENT_COUNT] = {};   // cost of one read
+
+#ifdef __linux__
+
+static constexpr int PERF_CALIBRATION_READS = 4096;
+
+// Open events of one group, in group order; fds[0] leads it
+static int g_perf_fds[PERF_EVENT_COUNT];
+static PerfEvent g_perf_events[PERF_EVENT_COUNT];
+static perf_event_mmap_page* g_perf_pages[PERF_EVENT_COUNT] = {};
+static int g_perf_open = 0;
+static bool g_perf_rdpmc = false;
+
+static bool OpenEvent(PerfEvent e, uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    // The leader is pinned: the group never shares the PMU, so counts
+    // need no scaling
+    int leader = g_perf_open ? g_perf_fds[0] : -1;
+    if (leader < 0) {
+        attr.disabled = 1;
+        attr.pinned = 1;
+    }
+
+    int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+    if (fd < 0) return false;
+    g_perf_fds[g_perf_open] = fd;
+    g_perf_events[g_perf_open] = e;
+    ++g_perf_open;
+    g_perf_available |= 1u << static_cast<int>(e);
+    return true;
+}
+
+static uint64_t CacheMissConfig(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+// Current counts by PerfEvent. With rdpmc the counters are read in user
+// space through each event's mmap page; otherwise one read() of the group.
+static bool ReadCounters(uint64_t* counts) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (g_perf_rdpmc) {
+        for (int i = 0; i < g_perf_open; ++i) {
+            volatile perf_event_mmap_page* pc = g_perf_pages[i];
+            uint32_t seq, index;
+            uint64_t count;
+            do {
+                seq = pc->lock;
+                __asm__ __volatile__("" ::: "memory");
+                index = pc->index;
+                count = pc->offset;
+                if (pc->cap_user_rdpmc && index) {
+                    int64_t pmc = static_cast<int64_t>(__rdpmc(index - 1));
+                    int shift = 64 - pc->pmc_width;
+                    count += static_cast<uint64_t>((pmc << shift) >> shift);
+                }
+                __asm__ __volatile__("" ::: "memory");
+            } while (pc->lock != seq);
+            counts[static_cast<int>(g_perf_events[i])] = count;
+        }
+        return true;
+    }
+#endif
+    uint64_t values[1 + PERF_EVENT_COUNT];
+    ssize_t bytes = read(g_perf_fds[0], values, sizeof(values));
+    if (bytes < static_cast<ssize_t>(sizeof(uint64_t) * (1 + g_perf_open))) return false;
+    for (int i = 0; i < g_perf_open; ++i) {
+        counts[static_cast<int>(g_perf_events[i])] = values[1 + i];
+    }
+    return true;
+}
+
+void StartPerfCounters(int world_rank) {
+    g_perf_started = true;
+
+    OpenEvent(PerfEvent::Cycles,       PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    OpenEvent(PerfEvent::Instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    OpenEvent(PerfEvent::L1dMisses,    PERF_TYPE_HW_CACHE, CacheMissConfig(PERF_COUNT_HW_CACHE_L1D));
+    OpenEvent(PerfEvent::LlcMisses,    PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    OpenEvent(PerfEvent::BranchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    int hw_error = errno;
+    if (g_perf_open == 0) {
+        if (world_rank == 0) {
+            std::cerr << "Warning: no hardware counters (" << strerror(hw_error)
+                      << "), counting task-clock only" << std::endl;
+        }
+        OpenEvent(PerfEvent::TaskClock, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK);
+    }
+    if (g_perf_open == 0) {
+        if (world_rank == 0) {
+            std::cerr << "Warning: perf_event_open failed (" << strerror(errno)
+                      << "; see /proc/sys/kernel/perf_event_paranoid), --perf ignored" << std::endl;
+        }
+        return;
+    }
+
+    // rdpmc only if every event of the group allows it
+    g_perf_rdpmc = true;
+    long page = sysconf(_SC_PAGESIZE);
+    for (int i = 0; i < g_perf_open; ++i) {
+        void* p = mmap(nullptr, page, PROT_READ, MAP_SHARED, g_perf_fds[i], 0);
+        if (p == MAP_FAILED) {
+            g_perf_rdpmc = false;
+            continue;
+        }
+        g_perf_pages[i] = static_cast<perf_event_mmap_page*>(p);
+    }
+
+    ioctl(g_perf_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(g_perf_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    for (int i = 0; i < g_perf_open && g_perf_rdpmc; ++i) {
+        g_perf_rdpmc = g_perf_pages[i]->cap_user_rdpmc;
+    }
+#if !defined(__x86_64__) && !defined(__i386__)
+    g_perf_rdpmc = false;
+#endif
+
+    // A pinned group that cannot be scheduled reads as nothing
+    uint64_t first[PERF_EVENT_COUNT] = {};
+    if (!ReadCounters(first)) {
+        if (world_rank == 0) {
+            std::cerr << "Warning: counters could not be scheduled, --perf ignored" << std::endl;
+        }
+        g_perf_available = 0;
+        return;
+    }
+
+    // Cost of one read: the counts between back-to-back reads
+    uint64_t last[PERF_EVENT_COUNT] = {};
+    for (int k = 0; k < PERF_CALIBRATION_READS; ++k) ReadCounters(last);
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+        g_perf_probe[e] = (last[e] - first[e]) / PERF_CALIBRATION_READS;
+    }
+
+    ReadCounters(g_perf_last);
+    g_perf_kernel = Kernel::Other;
+    g_perf_counting = true;
+}
+
+static void StopPerfCounters() {
+    for (int i = 0; i < g_perf_open; ++i) {
+        if (g_perf_pages[i]) munmap(g_perf_pages[i], sysconf(_SC_PAGESIZE));
+    }
+    for (int i = g_perf_open - 1; i >= 0; --i) close(g_perf_fds[i]);
+    g_perf_open = 0;
+}
+
+#else
+
+static bool ReadCounters(uint64_t* counts) { (void)counts; return false; }
+
+void StartPerfCounters(int world_rank) {
+    g_perf_started = true;
+    if (world_rank == 0) {
+        std::cerr << "Warning: --perf needs Linux perf_event_open, ignored" << std::endl;
+    }
+}
+
+static void StopPerfCounters() {}
+
+#endif
+
+void PerfSample() {
+    uint64_t now[PERF_EVENT_COUNT] = {};
+    if (!ReadCounters(now)) return;
+
+    PerfBucket& phase  = g_perf_phases[static_cast<int>(g_timing.current)];
+    PerfBucket& kernel = g_perf_kernels[static_cast<int>(g_perf_kernel)];
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+        uint64_t delta = now[e] - g_perf_last[e];
+        phase.count[e]  += delta;
+        kernel.count[e] += delta;
+        g_perf_last[e] = now[e];
+    }
+    ++phase.intervals;
+    ++kernel.intervals;
+}
+
+void PerfEnter(Kernel k) {
+    PerfSample();
+    ++g_perf_calls[static_cast<int>(k)];
+    g_perf_kernel = k;
+}
+
+void PerfLeave(Kernel prev) {
+    PerfSample();
+    g_perf_kernel = prev;
+}
+
+// ----------------- Report -----------------
+
+// Each interval holds about one read: the end of the read that opened it
+// and the start of the one that closed it
+static void SubtractProbes(PerfBucket& b) {
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+        uint64_t probes = b.intervals * g_perf_probe[e];
+        b.count[e] = b.count[e] > probes ? b.count[e] - probes : 0;
+    }
+}
+
+static bool Has(unsigned available, PerfEvent e) {
+    return available & (1u << static_cast<int>(e));
+}
+
+// Calls, counts in millions, IPC, misses per 1000 instructions, task ms
+static void PrintPerfRow(const std::string& label, const uint64_t* count, const std::string& calls,
+                         unsigned available) {
+    auto ratio = [&](PerfEvent num, PerfEvent den, double scale) {
+        std::ostringstream s;
+        s << std::fixed << std::setprecision(2);
+        if (Has(available, num) && Has(available, den) && count[static_cast<int>(den)]) {
+            s << scale * count[static_cast<int>(num)] / count[static_cast<int>(den)];
+        } else {
+            s << "n/a";
+        }
+        return s.str();
+    };
+    auto millions = [&](PerfEvent e) {
+        std::ostringstream s;
+        s << std::fixed << std::setprecision(1);
+        if (Has(available, e)) s << count[static_cast<int>(e)] / 1e6;
+        else s << "n/a";
+        return s.str();
+    };
+    std::ostringstream ms;
+    ms << std::fixed << std::setprecision(3);
+    if (Has(available, PerfEvent::TaskClock)) ms << count[static_cast<int>(PerfEvent::TaskClock)] / 1e6;
+    else ms << "n/a";
+
+    std::cout << "[PERF] " << std::left << std::setw(18) << label << std::right
+              << std::setw(11) << calls
+              << std::setw(11) << millions(PerfEvent::Cycles)
+              << std::setw(11) << millions(PerfEvent::Instructions)
+              << std::setw(7)  << ratio(PerfEvent::Instructions, PerfEvent::Cycles, 1.0)
+              << std::setw(9)  << ratio(PerfEvent::L1dMisses, PerfEvent::Instructions, 1e3)
+              << std::setw(9)  << ratio(PerfEvent::LlcMisses, PerfEvent::Instructions, 1e3)
+              << std::setw(9)  << ratio(PerfEvent::BranchMisses, PerfEvent::Instructions, 1e3)
+              << std::setw(11) << ms.str() << "\n";
+}
+
+void ReportPerfCounters(int world_rank) {
+    if (!g_perf_started) return;
+    if (g_perf_counting) PerfSample();
+    g_perf_counting = false;
+    StopPerfCounters();
+
+    int size = 1;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // Per rank: available events, then per phase and per kernel the
+    // calls (kernels only) and counts
+    constexpr int ROW = 1 + PERF_EVENT_COUNT;
+    constexpr int REGIONS = PHASE_COUNT + KERNEL_COUNT;
+    constexpr int N = 1 + REGIONS * ROW;
+    uint64_t local[N] = {};
+    local[0] = g_perf_available;
+    for (int r = 0; r < REGIONS; ++r) {
+        bool is_phase = r < PHASE_COUNT;
+        PerfBucket& b = is_phase ? g_perf_phases[r] : g_perf_kernels[r - PHASE_COUNT];
+        SubtractProbes(b);
+        local[1 + r * ROW] = is_phase ? 0 : g_perf_calls[r - PHASE_COUNT];
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e) local[1 + r * ROW + 1 + e] = b.count[e];
+    }
+
+    std::vector<uint64_t> all(world_rank == 0 ? static_cast<size_t>(N) * size : 0);
+    MPI_Gather(local, N, MPI_UINT64_T, all.data(), N, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    if (world_rank != 0) return;
+
+    // Events counted on every rank
+    unsigned available = ~0u;
+    for (int rank = 0; rank < size; ++rank) {
+        available &= static_cast<unsigned>(all[static_cast<size_t>(rank) * N]);
+    }
+    if (!available) {
+        std::cout << "[PERF] no counters available\n";
+        return;
+    }
+    auto region = [&](int rank, int r) { return &all[static_cast<size_t>(rank) * N + 1 + r * ROW]; };
+
+    std::cout << "[PERF] user space, main thread of each rank; one read costs";
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+        if (Has(available, static_cast<PerfEvent>(e))) {
+            std::cout << " " << g_perf_probe[e] << " " << PERF_EVENT_NAMES[e];
+        }
+    }
+    std::cout << " on rank 0 (subtracted)\n";
+    std::cout << "[PERF] region                  calls   cycles M    instr M    IPC"
+                 "  L1d/ki   LLC/ki    br/ki    task ms\n";
+
+    // Summed over ranks
+    for (int r = 0; r < REGIONS; ++r) {
+        uint64_t sum[ROW] = {};
+        for (int rank = 0; rank < size; ++rank) {
+            for (int i = 0; i < ROW; ++i) sum[i] += region(rank, r)[i];
+        }
+        bool is_phase = r < PHASE_COUNT;
+        bool any = sum[0] > 0;
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e) any = any || sum[1 + e];
+        if (!any) continue;
+        std::string label = is_phase ? std::string("phase ") + PHASE_NAMES[r]
+                                     : std::string("kernel ") + KERNEL_NAMES[r - PHASE_COUNT];
+        PrintPerfRow(label, sum + 1, is_phase ? "-" : std::to_string(sum[0]), available);
+    }
+
+    // Kernels per rank
+    if (size > 1) {
+        for (int rank = 0; rank < size; ++rank) {
+            for (int k = 1; k < KERNEL_COUNT; ++k) {
+                const uint64_t* row = region(rank, PHASE_COUNT + k);
+                if (!row[0]) continue;
+                PrintPerfRow("rank " + std::to_string(rank) + " " + KERNEL_NAMES[k],
+                             row + 1, std::to_string(row[0]), available);
+            }
+        }
+    }
+
+    // Per rank counts on one line
+    std::ostringstream json;
+    json << "{\"ranks\":" << size << ",\"events\":[";
+    bool first = true;
+    for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+        if (!Has(available, static_cast<PerfEvent>(e))) continue;
+        json << (first ? "" : ",") << "\"" << PERF_EVENT_NAMES[e] << "\"";
+        first = false;
+    }
+    for (int r = 0; r < REGIONS; ++r) {
+        bool is_phase = r < PHASE_COUNT;
+        if (r == 0) json << "],\"phases\":{";
+        if (r == PHASE_COUNT) json << "},\"kernels\":{";
+        int index = is_phase ? r : r - PHASE_COUNT;
+        json << (index ? "," : "") << "\""
+             << (is_phase ? PHASE_NAMES[index] : KERNEL_NAMES[index]) << "\":{";
+        bool first_field = true;
+        for (int i = is_phase ? 1 : 0; i < ROW; ++i) {
+            if (i > 0 && !Has(available, static_cast<PerfEvent>(i - 1))) continue;
+            json << (first_field ? "" : ",") << "\"" << (i ? PERF_EVENT_NAMES[i - 1] : "calls") << "\":[";
+            first_field = false;
+            for (int rank = 0; rank < size; ++rank) {
+                json << (rank ? "," : "") << region(rank, r)[i];
+            }
+            json << "]";
+        }
+        json << "}";
+    }
+    json << "}}";
+    std::cout << "[PERF][JSON] " << json.str() << "\n";
+}
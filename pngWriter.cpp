@@ -0,0 +1,436 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "Include/pngWriter.h"
+#include "Include/timing.h"
+
+// Rows per band: enough work per thread, small enough to balance
+static constexpr int PNG_MIN_BAND_ROWS = 16;
+static constexpr int PNG_BANDS_PER_THREAD = 4;
+
+// Cap on filtered bytes per band: bounds per-thread memory (and keeps LZ77
+// positions in int range) for gigapixel films
+static constexpr size_t PNG_MAX_BAND_BYTES = size_t(16) << 20;
+
+// LZ77 parameters (deflate limits and a chain depth similar to stb's level 8)
+static constexpr int LZ_WINDOW    = 32768;
+static constexpr int LZ_MIN_MATCH = 3;
+static constexpr int LZ_MAX_MATCH = 258;
+static constexpr int LZ_HASH_BITS = 15;
+static constexpr int LZ_MAX_CHAIN = 32;
+
+// ----------------- CRC32 / Adler32 -----------------
+
+static uint32_t crcTable[256];
+
+static void initCrcTable() {
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        crcTable[n] = c;
+    }
+}
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t* p, size_t n) {
+    crc = ~crc;
+    for (size_t i = 0; i < n; ++i) crc = crcTable[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static constexpr uint32_t ADLER_BASE = 65521;
+
+static uint32_t adler32(const uint8_t* p, size_t n) {
+    uint32_t a = 1, b = 0;
+    while (n > 0) {
+        size_t chunk = std::min<size_t>(n, 5552);   // no overflow before the modulo
+        for (size_t i = 0; i < chunk; ++i) {
+            a += p[i];
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+        p += chunk;
+        n -= chunk;
+    }
+    return (b << 16) | a;
+}
+
+// Adler32 of A followed by B, from adler(A), adler(B) and len(B)
+static uint32_t adler32Combine(uint32_t a1, uint32_t a2, size_t len2) {
+    uint64_t rem  = len2 % ADLER_BASE;
+    uint64_t sum1 = a1 & 0xffff;
+    uint64_t sum2 = (rem * sum1) % ADLER_BASE;
+    sum1 += (a2 & 0xffff) + ADLER_BASE - 1;
+    sum2 += (a1 >> 16) + (a2 >> 16) + ADLER_BASE - rem;
+    if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+    if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+    if (sum2 >= (uint64_t(ADLER_BASE) << 1)) sum2 -= (uint64_t(ADLER_BASE) << 1);
+    if (sum2 >= ADLER_BASE) sum2 -= ADLER_BASE;
+    return static_cast<uint32_t>(sum1 | (sum2 << 16));
+}
+
+// ----------------- Deflate (fixed Huffman) -----------------
+
+struct BitWriter {
+    std::vector<uint8_t> out;
+    uint32_t acc = 0;
+    int count = 0;
+
+    // LSB-first, as deflate stores everything but Huffman codes
+    void put(uint32_t bits, int n) {
+        acc |= bits << count;
+        count += n;
+        while (count >= 8) {
+            out.push_back(static_cast<uint8_t>(acc));
+            acc >>= 8;
+            count -= 8;
+        }
+    }
+
+    // Huffman codes go MSB-first
+    void putCode(uint32_t code, int n) {
+        uint32_t rev = 0;
+        for (int i = 0; i < n; ++i) rev |= ((code >> i) & 1) << (n - 1 - i);
+        put(rev, n);
+    }
+
+    void alignToByte() {
+        if (count > 0) put(0, 8 - count);
+    }
+};
+
+static const int lenBase[]  = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258 };
+static const int lenExtra[] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+static const int distBase[]  = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577 };
+static const int distExtra[] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+static void putLiteralLength(BitWriter& bw, int sym) {
+    if      (sym <= 143) bw.putCode(0x30 + sym, 8);
+    else if (sym <= 255) bw.putCode(0x190 + sym - 144, 9);
+    else if (sym <= 279) bw.putCode(sym - 256, 7);
+    else                 bw.putCode(0xc0 + sym - 280, 8);
+}
+
+static void putMatch(BitWriter& bw, int len, int dist) {
+    int li = 28;
+    while (lenBase[li] > len) --li;
+    putLiteralLength(bw, 257 + li);
+    if (lenExtra[li]) bw.put(len - lenBase[li], lenExtra[li]);
+
+    int di = 29;
+    while (distBase[di] > dist) --di;
+    bw.putCode(di, 5);
+    if (distExtra[di]) bw.put(dist - distBase[di], distExtra[di]);
+}
+
+static inline uint32_t hash3(const uint8_t* p) {
+    uint32_t h = (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2];
+    return (h * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// One fixed-Huffman block over data. Non-final blocks end with an empty
+// stored block (sync flush) so the next segment starts byte-aligned.
+static void deflateSegment(const uint8_t* data, size_t n, bool final, BitWriter& bw) {
+    bw.put(final ? 1 : 0, 1);   // BFINAL
+    bw.put(1, 2);               // BTYPE = fixed Huffman
+
+    std::vector<int> head(1 << LZ_HASH_BITS, -1);
+    std::vector<int> prev(n, -1);
+
+    size_t i = 0;
+    while (i < n) {
+        int best_len = 0, best_dist = 0;
+
+        if (i + LZ_MIN_MATCH <= n) {
+            uint32_t h = hash3(data + i);
+            int max_len = static_cast<int>(std::min<size_t>(LZ_MAX_MATCH, n - i));
+            int cand = head[h];
+            for (int chain = 0; cand >= 0 && chain < LZ_MAX_CHAIN; ++chain) {
+                int dist = static_cast<int>(i) - cand;
+                if (dist > LZ_WINDOW) break;
+                if (data[cand + best_len] == data[i + best_len]) {
+                    int len = 0;
+                    while (len < max_len && data[cand + len] == data[i + len]) ++len;
+                    if (len > best_len) {
+                        best_len = len;
+                        best_dist = dist;
+                        if (len == max_len) break;
+                    }
+                }
+                cand = prev[cand];
+            }
+        }
+
+        int advance = best_len >= LZ_MIN_MATCH ? best_len : 1;
+        if (best_len >= LZ_MIN_MATCH) putMatch(bw, best_len, best_dist);
+        else                          putLiteralLength(bw, data[i]);
+
+        // insert every covered position into the hash chains
+        for (int k = 0; k < advance; ++k, ++i) {
+            if (i + LZ_MIN_MATCH <= n) {
+                uint32_t h = hash3(data + i);
+                prev[i] = head[h];
+                head[h] = static_cast<int>(i);
+            }
+        }
+    }
+
+    putLiteralLength(bw, 256);   // end of block
+
+    if (!final) {
+        bw.put(0, 1);            // BFINAL = 0
+        bw.put(0, 2);            // BTYPE = stored
+        bw.alignToByte();
+        const uint8_t empty[4] = { 0x00, 0x00, 0xff, 0xff };
+        bw.out.insert(bw.out.end(), empty, empty + 4);
+    } else {
+        bw.alignToByte();
+    }
+}
+
+// ----------------- PNG filtering -----------------
+
+static inline uint8_t paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+    if (pb <= pc) return static_cast<uint8_t>(b);
+    return static_cast<uint8_t>(c);
+}
+
+// Apply PNG filter type (0-4) to one row; up is null for row 0
+static void applyFilter(int type, const uint8_t* row, const uint8_t* up,
+                        int bytes, uint8_t* out) {
+    const int bpp = 4;
+    static const uint8_t zeros[bpp] = {};
+    if (!up) {
+        // row 0: "up" is all zeros, so up and paeth reduce to simpler filters
+        if (type == 2) type = 0;
+        if (type == 4) type = 1;
+    }
+
+    switch (type) {
+        case 0:
+            std::memcpy(out, row, bytes);
+            break;
+        case 1:
+            for (int i = 0; i < bpp; ++i) out[i] = row[i];
+            for (int i = bpp; i < bytes; ++i) out[i] = row[i] - row[i - bpp];
+            break;
+        case 2:
+            for (int i = 0; i < bytes; ++i) out[i] = row[i] - up[i];
+            break;
+        case 3: {
+            const uint8_t* u = up ? up : zeros;
+            int ustep = up ? 1 : 0;
+            for (int i = 0; i < bpp; ++i) out[i] = row[i] - (u[i * ustep] >> 1);
+            for (int i = bpp; i < bytes; ++i) out[i] = row[i] - ((row[i - bpp] + u[i * ustep]) >> 1);
+            break;
+        }
+        case 4:
+            for (int i = 0; i < bpp; ++i) out[i] = row[i] - up[i];
+            for (int i = bpp; i < bytes; ++i) out[i] = row[i] - paeth(row[i - bpp], up[i], up[i - bpp]);
+            break;
+    }
+}
+
+// Filter one row with the type whose output has the smallest sum of
+// absolute signed bytes, as stb_image_write does. out[0] gets the type.
+static void filterRow(const uint8_t* row, const uint8_t* up, int bytes,
+                      uint8_t* out, uint8_t* scratch) {
+    long best_est = -1;
+
+    for (int type = 0; type < 5; ++type) {
+        applyFilter(type, row, up, bytes, scratch);
+
+        long est = 0;
+        for (int i = 0; i < bytes; ++i) est += std::abs(static_cast<int8_t>(scratch[i]));
+        if (best_est < 0 || est < best_est) {
+            best_est = est;
+            out[0] = static_cast<uint8_t>(type);
+            std::memcpy(out + 1, scratch, bytes);
+        }
+    }
+}
+
+// ----------------- PNG file -----------------
+
+static void put32(std::vector<uint8_t>& v, uint32_t x) {
+    v.push_back(static_cast<uint8_t>(x >> 24));
+    v.push_back(static_cast<uint8_t>(x >> 16));
+    v.push_back(static_cast<uint8_t>(x >> 8));
+    v.push_back(static_cast<uint8_t>(x));
+}
+
+// Chunk = length, tag, data, CRC over tag and data
+static std::vector<uint8_t> makeChunk(const char* tag, const uint8_t* data, size_t n) {
+    std::vector<uint8_t> chunk;
+    chunk.reserve(n + 12);
+    put32(chunk, static_cast<uint32_t>(n));
+    chunk.insert(chunk.end(), tag, tag + 4);
+    chunk.insert(chunk.end(), data, data + n);
+    put32(chunk, crc32Update(0, chunk.data() + 4, n + 4));
+    return chunk;
+}
+
+struct PngBand {
+    int y0, y1;
+    std::vector<uint8_t> idat;   // complete IDAT chunk
+    uint32_t adler = 1;          // of this band's filtered bytes
+    size_t filtered_bytes = 0;
+};
+
+// Filter and deflate band.y1 - band.y0 rows starting at rows; up is the
+// image row above them (null at the top of the image)
+static void encodeBand(PngBand& band, const uint8_t* rows, const uint8_t* up,
+                       int width, bool first, bool last) {
+    int row_bytes = width * 4;
+    size_t n = static_cast<size_t>(band.y1 - band.y0) * (row_bytes + 1);
+    std::vector<uint8_t> filtered(n);
+    std::vector<uint8_t> scratch(row_bytes);
+
+    for (int y = band.y0; y < band.y1; ++y) {
+        const uint8_t* row = rows + static_cast<size_t>(y - band.y0) * row_bytes;
+        filterRow(row, y > band.y0 ? row - row_bytes : up, row_bytes,
+                  filtered.data() + static_cast<size_t>(y - band.y0) * (row_bytes + 1),
+                  scratch.data());
+    }
+
+    band.adler = adler32(filtered.data(), n);
+    band.filtered_bytes = n;
+
+    BitWriter bw;
+    if (first) {
+        bw.out.push_back(0x78);   // zlib header: deflate, 32K window
+        bw.out.push_back(0x01);
+    }
+    deflateSegment(filtered.data(), n, last, bw);
+    band.idat = makeChunk("IDAT", bw.out.data(), bw.out.size());
+}
+
+static bool writeBytes(FILE* f, const std::vector<uint8_t>& v) {
+    return fwrite(v.data(), 1, v.size(), f) == v.size();
+}
+
+// Signature and IHDR (8-bit RGBA, no interlace)
+static bool writeHeader(FILE* f, int width, int height) {
+    std::vector<uint8_t> ihdr;
+    put32(ihdr, static_cast<uint32_t>(width));
+    put32(ihdr, static_cast<uint32_t>(height));
+    const uint8_t ihdr_rest[5] = { 8, 6, 0, 0, 0 };
+    ihdr.insert(ihdr.end(), ihdr_rest, ihdr_rest + 5);
+
+    const uint8_t sig[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    bool ok = fwrite(sig, 1, 8, f) == 8;
+    return ok && writeBytes(f, makeChunk("IHDR", ihdr.data(), ihdr.size()));
+}
+
+// zlib trailer (Adler32 of all filtered bytes) in its own IDAT chunk, then IEND
+static bool writeTrailer(FILE* f, uint32_t adler) {
+    std::vector<uint8_t> trailer;
+    put32(trailer, adler);
+    bool ok = writeBytes(f, makeChunk("IDAT", trailer.data(), trailer.size()));
+    return ok && writeBytes(f, makeChunk("IEND", nullptr, 0));
+}
+
+bool WritePngParallel(const char* fname, const uint8_t* rgba,
+                      int width, int height, int threads) {
+    static bool crc_ready = (initCrcTable(), true);
+    (void)crc_ready;
+
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    int band_rows = std::max(PNG_MIN_BAND_ROWS,
+                             height / (threads * PNG_BANDS_PER_THREAD) + 1);
+    size_t filtered_row = static_cast<size_t>(width) * 4 + 1;
+    band_rows = std::min<size_t>(band_rows, std::max<size_t>(1, PNG_MAX_BAND_BYTES / filtered_row));
+    std::vector<PngBand> bands;
+    for (int y = 0; y < height; y += band_rows) {
+        PngBand b;
+        b.y0 = y;
+        b.y1 = std::min(height, y + band_rows);
+        bands.push_back(std::move(b));
+    }
+    int n_bands = static_cast<int>(bands.size());
+
+    std::atomic<int> next(0);
+    auto worker = [&]() {
+        for (int b = next++; b < n_bands; b = next++) {
+            TraceSpan span("encode band", "write", bands[b].y0);
+            const uint8_t* rows = rgba + static_cast<size_t>(bands[b].y0) * width * 4;
+            encodeBand(bands[b], rows, b > 0 ? rows - width * 4 : nullptr,
+                       width, b == 0, b == n_bands - 1);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < std::min(threads, n_bands); ++t) pool.emplace_back(worker);
+    worker();
+    for (std::thread& t : pool) t.join();
+
+    uint32_t adler = 1;
+    for (const PngBand& b : bands) adler = adler32Combine(adler, b.adler, b.filtered_bytes);
+
+    FILE* f = fopen(fname, "wb");
+    if (!f) return false;
+
+    bool ok = writeHeader(f, width, height);
+    for (const PngBand& b : bands) ok = ok && writeBytes(f, b.idat);
+    ok = ok && writeTrailer(f, adler);
+
+    return fclose(f) == 0 && ok;
+}
+
+// ----------------- Streaming PNG writer -----------------
+
+PngStream::~PngStream() {
+    if (f) fclose(f);
+}
+
+bool PngStream::open(const char* fname, int w, int h) {
+    static bool crc_ready = (initCrcTable(), true);
+    (void)crc_ready;
+
+    width = w;
+    height = h;
+    rows_written = 0;
+    adler = 1;
+    last_row.assign(static_cast<size_t>(width) * 4, 0);
+
+    f = fopen(fname, "wb");
+    ok = f && writeHeader(f, width, height);
+    return ok;
+}
+
+bool PngStream::writeRows(const uint8_t* rgba, int rows) {
+    size_t row_bytes = static_cast<size_t>(width) * 4;
+    int max_rows = static_cast<int>(std::max<size_t>(1, PNG_MAX_BAND_BYTES / (row_bytes + 1)));
+
+    for (int done = 0; done < rows && ok && rows_written < height; done += max_rows) {
+        const uint8_t* chunk = rgba + row_bytes * done;
+
+        PngBand band;
+        band.y0 = rows_written;
+        band.y1 = std::min({ height, rows_written + rows - done, rows_written + max_rows });
+        encodeBand(band, chunk, rows_written > 0 ? last_row.data() : nullptr,
+                   width, rows_written == 0, band.y1 == height);
+
+        adler = adler32Combine(adler, band.adler, band.filtered_bytes);
+        std::memcpy(last_row.data(), chunk + row_bytes * (band.y1 - band.y0 - 1), row_bytes);
+        rows_written = band.y1;
+
+        ok = writeBytes(f, band.idat);
+    }
+    return ok;
+}
+
+bool PngStream::close() {
+    if (!f) return false;
+    ok = ok && rows_written == height && writeTrailer(f, adler);
+    ok = fclose(f) == 0 && ok;
+    f = nullptr;
+    return ok;
+}
@@ -33,3 +33,13 @@ Material* Sphere::getMaterial() const {
 Material* Triangle::getMaterial() const {
     return material;
 }
+
+static bool isBlack(const Color& c) {
+    return c.r == 0.0 && c.g == 0.0 && c.b == 0.0;
+}
+
+MaterialClass classifyMaterial(const Material& m) {
+    if (!isBlack(m.trans))    return MaterialClass::Transmissive;
+    if (!isBlack(m.specular)) return MaterialClass::Specular;
+    return MaterialClass::Diffuse;
+}
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "Include/render.h"
+#include "Include/intersect.h"
+#include "Include/lightGrid.h"
+#include "Include/rayTrace.h"
+#include "Include/stats.h"
+#include "Include/timing.h"
+
+RenderContext::RenderContext(const Scene& scene, int width, int height)
+    : scene(scene), width(width), height(height) {
+    // Basic camera parameters
+    float imgW = static_cast<float>(width);
+    float imgH = static_cast<float>(height);
+    halfW = imgW / 2.0f;
+    halfH = imgH / 2.0f;
+    float d = halfH / tanf(scene.camera_fov_ha * (M_PI / 180.0f));
+
+    cam_origin = scene.camera_pos - d * scene.camera_fwd;
+    step_x     = -scene.camera_right;
+
+    tiled = !scene.lightGrid.empty() && scene.max_depth > 0;
+    if (tiled) {
+        band_rays.resize(LIGHT_TILE * width);
+        band_hits.resize(LIGHT_TILE * width);
+        band_found.resize(LIGHT_TILE * width);
+    }
+}
+
+void RenderRows(RenderContext& ctx, int row0, int nrows, Framebuffer& fb, int fb_row0,
+                const AovBuffers* aovs) {
+    PhaseScope phase(Phase::Trace, "trace rows", row0);
+    const Scene& scene = ctx.scene;
+    const int img_width = ctx.width;
+    if (aovs && !aovs->any()) aovs = nullptr;
+    const bool cost = aovs && aovs->cost();
+    g_stats.primary_rays += static_cast<uint64_t>(nrows) * img_width;
+
+    for (int band0 = 0; band0 < nrows; band0 += LIGHT_TILE) {
+        int band_rows = std::min(LIGHT_TILE, nrows - band0);
+        ResetShadowCache(scene);
+
+        for (int lr = band0; lr < band0 + band_rows; ++lr) {
+            int j = row0 + lr;  // global row index
+            float v = ctx.halfH - static_cast<float>(j) + 0.5f;
+
+            // Starting point on the view plane for column 0
+            Point3 row_start = ctx.cam_origin
+                             + v * scene.camera_up
+                             + (ctx.halfW + 0.5f) * scene.camera_right;
+
+            Point3 p = row_start;
+
+            for (int i = 0; i < img_width; ++i) {
+                uint64_t cycles0 = cost ? CycleCount() : 0;
+                uint64_t tests0  = cost ? IntersectionTests() : 0;
+                Ray ray(scene.camera_pos, p - scene.camera_pos);
+
+                if (ctx.tiled) {
+                    int b = (lr - band0) * img_width + i;
+                    ctx.band_rays[b]  = ray;
+                    ctx.band_found[b] = FindIntersection(scene, ray, ctx.band_hits[b]);
+                    if (aovs) aovs->store(i, fb_row0 + lr, ctx.band_found[b] ? &ctx.band_hits[b] : nullptr);
+                } else if (aovs) {
+                    // rayTrace, keeping the primary hit
+                    HitInfo hit;
+                    bool found = FindIntersection(scene, ray, hit);
+                    aovs->store(i, fb_row0 + lr, found ? &hit : nullptr);
+                    Color result = scene.max_depth <= 0 ? Color(0, 0, 0)
+                                 : found ? ApplyLighting(scene, ray, hit, scene.max_depth)
+                                 : scene.background;
+                    fb.setPixel(i, fb_row0 + lr, result);
+                } else {
+                    fb.setPixel(i, fb_row0 + lr, rayTrace(ray, scene.max_depth, scene));
+                }
+                if (cost) {
+                    aovs->storeCost(i, fb_row0 + lr, CycleCount() - cycles0,
+                                    IntersectionTests() - tests0);
+                }
+
+                // Move to the next pixel in this row
+                p = p + ctx.step_x;
+            }
+        }
+
+        if (!ctx.tiled) continue;
+
+        for (int i0 = 0; i0 < img_width; i0 += LIGHT_TILE) {
+            int i1 = std::min(i0 + LIGHT_TILE, img_width);
+
+            // Bounds of the tile's primary hit points
+            const double INF = std::numeric_limits<double>::infinity();
+            Point3 lo(INF, INF, INF);
+            Point3 hi(-INF, -INF, -INF);
+            for (int r = 0; r < band_rows; ++r) {
+                for (int i = i0; i < i1; ++i) {
+                    int b = r * img_width + i;
+                    if (!ctx.band_found[b]) continue;
+                    const Point3& q = ctx.band_hits[b].point;
+                    lo = Point3(std::min(lo.x, q.x), std::min(lo.y, q.y), std::min(lo.z, q.z));
+                    hi = Point3(std::max(hi.x, q.x), std::max(hi.y, q.y), std::max(hi.z, q.z));
+                }
+            }
+            if (lo.x <= hi.x) scene.lightGrid.lightsInBox(lo, hi, ctx.tile_lights);
+            ResetShadowCache(scene);
+
+            for (int r = 0; r < band_rows; ++r) {
+                for (int i = i0; i < i1; ++i) {
+                    int b = r * img_width + i;
+                    uint64_t cycles0 = cost ? CycleCount() : 0;
+                    uint64_t tests0  = cost ? IntersectionTests() : 0;
+                    Color result = ctx.band_found[b]
+                        ? ApplyLighting(scene, ctx.band_rays[b], ctx.band_hits[b],
+                                        scene.max_depth, &ctx.tile_lights)
+                        : scene.background;
+                    fb.setPixel(i, fb_row0 + band0 + r, result);
+                    if (cost) {
+                        aovs->storeCost(i, fb_row0 + band0 + r, CycleCount() - cycles0,
+                                        IntersectionTests() - tests0, true);
+                    }
+                }
+            }
+        }
+    }
+}
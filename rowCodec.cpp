@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cstring>
+#include "Include/rowCodec.h"
+
+// Literal runs are capped so their header stays one byte
+static constexpr size_t RLE_MAX_LITERAL = 64;
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+static bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+static void flushLiteral(const uint8_t* pixels, size_t start, size_t end,
+                         size_t pixel_bytes, std::vector<uint8_t>& out) {
+    while (start < end) {
+        size_t n = std::min(end - start, RLE_MAX_LITERAL);
+        putVarint(out, (n - 1) << 1);
+        out.insert(out.end(), pixels + start * pixel_bytes, pixels + (start + n) * pixel_bytes);
+        start += n;
+    }
+}
+
+// PB > 0 fixes the pixel size at compile time so pixel compares inline
+template<size_t PB>
+static void encodeRle(const uint8_t* pixels, size_t n, size_t pixel_bytes,
+                      std::vector<uint8_t>& out) {
+    const size_t pb = PB ? PB : pixel_bytes;
+    size_t literal = 0;   // first pixel not yet emitted
+    size_t i = 0;
+    while (i < n) {
+        const uint8_t* p = pixels + i * pb;
+        size_t run = 1;
+        while (i + run < n && memcmp(p, p + run * pb, pb) == 0) ++run;
+
+        // Two equal pixels already cost less as a run than as literals
+        if (run >= 2) {
+            flushLiteral(pixels, literal, i, pb, out);
+            putVarint(out, ((run - 1) << 1) | 1);
+            out.insert(out.end(), p, p + pb);
+            literal = i + run;
+        }
+        i += run;
+    }
+    flushLiteral(pixels, literal, n, pb, out);
+}
+
+void EncodeRle(const uint8_t* pixels, size_t n, size_t pixel_bytes,
+               std::vector<uint8_t>& out) {
+    switch (pixel_bytes) {
+        case 4:  encodeRle<4>(pixels, n, pixel_bytes, out);  break;
+        case 12: encodeRle<12>(pixels, n, pixel_bytes, out); break;
+        default: encodeRle<0>(pixels, n, pixel_bytes, out);  break;
+    }
+}
+
+bool DecodeRle(const uint8_t* in, size_t in_bytes, uint8_t* pixels,
+               size_t n, size_t pixel_bytes) {
+    const uint8_t* p = in;
+    const uint8_t* end = in + in_bytes;
+    size_t done = 0;
+    while (done < n) {
+        uint64_t h;
+        if (!getVarint(p, end, h)) return false;
+        size_t count = static_cast<size_t>(h >> 1) + 1;
+        if (count > n - done) return false;
+
+        uint8_t* dst = pixels + done * pixel_bytes;
+        if (h & 1) {
+            if (static_cast<size_t>(end - p) < pixel_bytes) return false;
+            // Fill the run by doubling the already written part
+            size_t filled = pixel_bytes, bytes = count * pixel_bytes;
+            memcpy(dst, p, pixel_bytes);
+            while (filled < bytes) {
+                size_t chunk = std::min(filled, bytes - filled);
+                memcpy(dst + filled, dst, chunk);
+                filled += chunk;
+            }
+            p += pixel_bytes;
+        } else {
+            size_t bytes = count * pixel_bytes;
+            if (static_cast<size_t>(end - p) < bytes) return false;
+            memcpy(dst, p, bytes);
+            p += bytes;
+        }
+        done += count;
+    }
+    return p == end;
+}
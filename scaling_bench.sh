@@ -0,0 +1,161 @@
+#!/bin/bash
+# Strong-scaling benchmark: renders each scene at every rank count of the
+# sweep, several trials each, and reports speedup and parallel efficiency.
+#
+# usage: ./scaling_bench.sh [options] [scene ...]
+#   -b <binary>   renderer (default ./raytracer_mpi)
+#   -n "<list>"   rank counts (default "1 2 4 8 16 32 64")
+#   -t <trials>   trials per scene and rank count (default 3)
+#   -o <dir>      output directory (default bench_results/<timestamp>)
+#   -a "<args>"   extra renderer options, e.g. "--stream"
+#   -m "<args>"   extra mpirun options, e.g. "--oversubscribe"
+# Without scenes, every Tests/*/*.txt is run. Missing scenes are skipped.
+#
+# Output: runs.csv (one line per trial), summary.csv and summary.json
+# (median per scene and rank count), logs/ with every run's output.
+# Speedup and efficiency are relative to the smallest rank count that
+# completed for the scene: speedup = T(n0) / T(n) * n0, efficiency =
+# speedup / n. Tracing is single-threaded per rank, so the sweep is over
+# ranks only.
+set -u
+
+BIN=./raytracer_mpi
+NP_LIST="1 2 4 8 16 32 64"
+TRIALS=3
+OUT=""
+RENDER_ARGS=""
+MPI_ARGS=""
+
+while getopts "b:n:t:o:a:m:h" opt; do
+    case $opt in
+        b) BIN=$OPTARG ;;
+        n) NP_LIST=$OPTARG ;;
+        t) TRIALS=$OPTARG ;;
+        o) OUT=$OPTARG ;;
+        a) RENDER_ARGS=$OPTARG ;;
+        m) MPI_ARGS=$OPTARG ;;
+        *) sed -n '2,19p' "$0" | sed 's/^# \{0,1\}//'; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+if [ ! -f "$BIN" ] || [ ! -x "$BIN" ]; then
+    echo "Error: renderer $BIN not found; build it first (README step 5)" >&2
+    exit 1
+fi
+BIN=$(cd "$(dirname "$BIN")" && pwd)/$(basename "$BIN")
+
+# -------- scenes --------
+if [ $# -gt 0 ]; then
+    REQUESTED=("$@")
+else
+    REQUESTED=(Tests/*/*.txt)
+fi
+SCENES=()
+for s in "${REQUESTED[@]}"; do
+    if [ -f "$s" ]; then
+        SCENES+=("$s")
+    else
+        echo "Warning: scene $s not found, skipped" >&2
+    fi
+done
+if [ ${#SCENES[@]} -eq 0 ]; then
+    echo "Error: no scenes to run" >&2
+    exit 1
+fi
+
+[ -z "$OUT" ] && OUT="bench_results/$(date +%Y%m%d-%H%M%S)"
+mkdir -p "$OUT/logs" "$OUT/images"
+OUT=$(cd "$OUT" && pwd)
+RUNS="$OUT/runs.csv"
+
+echo "Scaling benchmark: ${#SCENES[@]} scene(s), ranks: $NP_LIST, $TRIALS trial(s) each"
+echo "Host: $(hostname), renderer: $BIN ${RENDER_ARGS}"
+echo "Results in $OUT"
+echo ""
+
+# -------- runs --------
+echo "scene,np,trial,status,total_ms,trace_ms,trace_imbalance,mrays_per_s" > "$RUNS"
+for scene in "${SCENES[@]}"; do
+    name=$(echo "${scene%.txt}" | tr '/' '_')
+    scene_path=$(cd "$(dirname "$scene")" && pwd)/$(basename "$scene")
+    for np in $NP_LIST; do
+        for trial in $(seq 1 "$TRIALS"); do
+            log="$OUT/logs/${name}_np${np}_t${trial}.log"
+            printf "%-40s np=%-4s trial %s: " "$scene" "$np" "$trial"
+
+            # Images land in images/, not in the caller's directory
+            (cd "$OUT/images" && mpirun $MPI_ARGS -np "$np" "$BIN" "$scene_path" $RENDER_ARGS) > "$log" 2>&1
+            code=$?
+
+            total=$(awk '/^\[TIMING\]\[MPI\] total:/ {print $3}' "$log")
+            trace=$(awk '/^\[TIMING\]\[MPI\] trace:/ {print $3}' "$log")
+            imbalance=$(awk '/^\[TIMING\] trace imbalance/ {print $NF}' "$log")
+            mrays=$(awk '/^\[TIMING\] rays / {for (i = 1; i < NF; ++i) if ($(i + 1) == "Mrays/s") print $i}' "$log")
+            if [ $code -ne 0 ] || [ -z "$total" ]; then
+                echo "failed (exit $code, see $log)"
+                echo "$scene,$np,$trial,failed,,,," >> "$RUNS"
+                continue
+            fi
+            echo "$total ms"
+            echo "$scene,$np,$trial,ok,$total,$trace,$imbalance,$mrays" >> "$RUNS"
+        done
+    done
+done
+
+# -------- summary --------
+# Median of the completed trials per scene and rank count, then speedup
+# and efficiency against the scene's smallest completed rank count
+awk -F, -v csv="$OUT/summary.csv" -v json="$OUT/summary.json" '
+function median(list,    n, v, i, j, t) {
+    n = split(list, v, " ")
+    for (i = 2; i <= n; ++i) for (j = i; j > 1 && v[j - 1] + 0 > v[j] + 0; --j) {
+        t = v[j]; v[j] = v[j - 1]; v[j - 1] = t
+    }
+    return n % 2 ? v[(n + 1) / 2] : (v[n / 2] + v[n / 2 + 1]) / 2
+}
+NR > 1 && $4 == "ok" {
+    key = $1 SUBSEP $2
+    if (!(key in count)) {
+        if (!($1 in seen)) { seen[$1] = 1; order[++scenes] = $1 }
+        nps[$1] = nps[$1] " " $2
+    }
+    ++count[key]
+    total[key] = total[key] " " $5
+    trace[key] = trace[key] " " $6
+    imb[key]   = imb[key] " " $7
+    mrays[key] = mrays[key] " " $8
+}
+END {
+    print "scene,np,trials,total_ms,trace_ms,trace_imbalance,mrays_per_s,speedup,efficiency" > csv
+    printf "{\"results\":[" > json
+    printf "\n%-40s %5s %7s %12s %12s %9s %9s %8s %6s\n", "scene", "np", "trials", "total ms", "trace ms", "imbal", "Mrays/s", "speedup", "eff"
+    first = 1
+    for (s = 1; s <= scenes; ++s) {
+        sc = order[s]
+        n = split(nps[sc], list, " ")
+        base_np = 0
+        for (i = 1; i <= n; ++i) if (!base_np || list[i] + 0 < base_np) base_np = list[i] + 0
+        base = median(total[sc SUBSEP base_np])
+        for (i = 1; i <= n; ++i) {
+            np = list[i]; key = sc SUBSEP np
+            t = median(total[key])
+            speedup = t > 0 ? base / t * base_np : 0
+            eff = speedup / np
+            printf "%s,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", sc, np, count[key], t,
+                   median(trace[key]), median(imb[key]), median(mrays[key]), speedup, eff >> csv
+            printf "%s{\"scene\":\"%s\",\"np\":%d,\"trials\":%d,\"total_ms\":%.3f,\"trace_ms\":%.3f,\"trace_imbalance\":%.3f,\"mrays_per_s\":%.3f,\"speedup\":%.3f,\"efficiency\":%.3f}",
+                   first ? "" : ",", sc, np, count[key], t, median(trace[key]), median(imb[key]),
+                   median(mrays[key]), speedup, eff >> json
+            first = 0
+            printf "%-40s %5d %7d %12.3f %12.3f %9.3f %9.3f %8.2f %6.2f\n", sc, np, count[key], t,
+                   median(trace[key]), median(imb[key]), median(mrays[key]), speedup, eff
+        }
+    }
+    print "]}" >> json
+}' "$RUNS"
+
+failed=$(awk -F, 'NR > 1 && $4 == "failed"' "$RUNS" | wc -l)
+echo ""
+[ "$failed" -gt 0 ] && echo "$failed run(s) failed; see runs.csv and logs/"
+echo "Wrote $RUNS, $OUT/summary.csv and $OUT/summary.json"
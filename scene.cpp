@@ -3,9 +3,11 @@
 #include <iostream>
 #include <cmath>
 #include <vector>
+#include "Include/aov.h"
 #include "Include/ray.h"
 #include "Include/rayTrace.h"
 #include "Include/scene.h"
+#include "Include/timing.h"
 #include "Include/types.h"
 
 // Trim leading and trailing whitespace from a string
@@ -34,6 +36,10 @@ Scene parseSceneFile(const std::string &filename,
     scene.background    = Color(0, 0, 0);
     scene.ambient_light = Color(0, 0, 0);
     scene.max_depth = 5;
+    scene.light_cutoff = 0.0;
+    scene.light_samples = 0;
+    scene.light_culling = LightCulling::Tree;
+    scene.aovs = 0;
 
 
     // Default image parameters
@@ -49,6 +55,7 @@ Scene parseSceneFile(const std::string &filename,
     material->ns       = 5.0;
     material->trans    = Color(0, 0, 0);
     material->ior      = 1.0;
+    material->shading  = classifyMaterial(*material);
 
     scene.materials.push_back(material);
 
@@ -109,6 +116,7 @@ Scene parseSceneFile(const std::string &filename,
                >> material->ns
                >> material->trans.r >> material->trans.g >> material->trans.b
                >> material->ior;
+            material->shading = classifyMaterial(*material);
 
             scene.materials.push_back(material);
 
@@ -204,6 +212,43 @@ Scene parseSceneFile(const std::string &filename,
         else if (key == "max_depth"){
             ss >> scene.max_depth;
         }
+        else if (key == "light_cutoff"){
+            ss >> scene.light_cutoff;
+        }
+        else if (key == "light_samples"){
+            ss >> scene.light_samples;
+        }
+        else if (key == "light_culling"){
+            std::string mode;
+            ss >> mode;
+            if (mode == "grid") {
+                scene.light_culling = LightCulling::Grid;
+            } else if (mode == "tree") {
+                scene.light_culling = LightCulling::Tree;
+            } else {
+                std::cerr << "Warning: unknown light_culling " << mode
+                          << " in " << filename << std::endl;
+            }
+        }
+        else if (key == "aovs"){
+            std::string name;
+            while (ss >> name) {
+                int a = 0;
+                while (a < AOV_COUNT && name != AovName(static_cast<Aov>(a))) ++a;
+                if (a < AOV_COUNT) {
+                    scene.aovs |= 1u << a;
+#ifdef RT_NO_STATS
+                    if (static_cast<Aov>(a) == Aov::Tests) {
+                        std::cerr << "Warning: the tests aov is all zero in a build with RT_NO_STATS"
+                                  << std::endl;
+                    }
+#endif
+                } else {
+                    std::cerr << "Warning: unknown aov " << name
+                              << " in " << filename << std::endl;
+                }
+            }
+        }
         else {
             std::cerr << "Warning: unknown key " << key << " in " << filename << std::endl;
         }
@@ -216,5 +261,27 @@ Scene parseSceneFile(const std::string &filename,
 
     scene.camera_fwd = scene.camera_fwd.normalized();
 
+    PhaseScope build(Phase::Build);
+    for (size_t i = 0; i < scene.lights.size(); ++i) {
+        scene.lights[i]->id = static_cast<int>(i);
+        scene.lights[i]->prepare(scene);
+    }
+
+    // Light hierarchy for cutoff culling over many point/spot lights or
+    // stochastic selection
+    int bounded_lights = 0;
+    for (const Light* l : scene.lights) {
+        LightBounds b;
+        if (l->getBounds(b)) ++bounded_lights;
+    }
+    bool many_lights = scene.light_cutoff > 0.0 &&
+                       bounded_lights >= LIGHT_TREE_MIN_LIGHTS;
+    if (scene.light_samples > 0 ||
+        (many_lights && scene.light_culling == LightCulling::Tree)) {
+        scene.lightTree.build(scene.lights);
+    } else if (many_lights) {
+        scene.lightGrid.build(scene);
+    }
+
     return scene;
 }
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include <mpi.h>
+#include <iostream>
+#include "Include/stats.h"
+
+RenderStats g_stats;
+
+void ReportStats(int world_rank) {
+    constexpr int n = sizeof(RenderStats) / sizeof(uint64_t);
+
+    RenderStats total;
+    MPI_Reduce(reinterpret_cast<uint64_t*>(&g_stats),
+               reinterpret_cast<uint64_t*>(&total),
+               n, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (world_rank != 0) return;
+
+#ifdef RT_NO_STATS
+    std::cout << "[STATS] primary rays: " << total.primary_rays
+              << " (other counters compiled out with RT_NO_STATS)\n";
+    return;
+#endif
+
+    uint64_t secondary = total.reflection_rays + total.refraction_rays;
+    std::cout << "[STATS] rays primary: " << total.primary_rays
+              << "  reflection: " << total.reflection_rays
+              << "  refraction: " << total.refraction_rays
+              << "  shadow: " << total.shadow_rays
+              << "  (depth-limited hits: " << total.depth_limited << ")\n";
+
+    // Tests per ray of each query kind
+    uint64_t hit_rays = total.primary_rays + secondary;
+    uint64_t shadow_queries = total.shadow_rays;
+    std::cout << "[STATS] closest-hit tests: " << total.hit_sphere_tests << " sphere + "
+              << total.hit_triangle_tests << " triangle ("
+              << (hit_rays ? double(total.hit_sphere_tests + total.hit_triangle_tests) / hit_rays : 0.0)
+              << " per ray)\n";
+    std::cout << "[STATS] shadow tests: " << total.shadow_sphere_tests << " sphere + "
+              << total.shadow_triangle_tests << " triangle ("
+              << (shadow_queries ? double(total.shadow_sphere_tests + total.shadow_triangle_tests) / shadow_queries : 0.0)
+              << " per ray)\n";
+    if (total.light_tree_nodes) {
+        std::cout << "[STATS] light tree nodes visited: " << total.light_tree_nodes
+                  << "  pruned: " << total.light_tree_pruned << "\n";
+    }
+
+    std::cout << "[STATS] shading diffuse: "
+              << total.shade_hits[static_cast<int>(MaterialClass::Diffuse)]
+              << "  specular: "
+              << total.shade_hits[static_cast<int>(MaterialClass::Specular)]
+              << "  transmissive: "
+              << total.shade_hits[static_cast<int>(MaterialClass::Transmissive)]
+              << "\n";
+
+    uint64_t hits = 0;
+    for (uint64_t h : total.shade_hits) hits += h;
+    std::cout << "[STATS] light evaluations: " << total.light_evals
+              << " (" << (hits ? double(total.light_evals) / hits : 0.0)
+              << " per hit)\n";
+
+    uint64_t culled = total.shadow_culled_cone + total.shadow_culled_backface
+                    + total.shadow_culled_cutoff;
+    std::cout << "[STATS] shadow rays traced: " << total.shadow_rays
+              << "  avoided: " << culled
+              << " (cone: " << total.shadow_culled_cone
+              << ", backface: " << total.shadow_culled_backface
+              << ", cutoff: " << total.shadow_culled_cutoff << ")"
+              << "  light-space grid: " << total.shadow_grid_rays << "\n";
+
+    std::cout << "[STATS] shadow cache hits: " << total.shadow_cache_hits
+              << " / " << total.shadow_cache_probes << " probes, "
+              << (total.shadow_occluded
+                      ? 100.0 * total.shadow_cache_hits / total.shadow_occluded
+                      : 0.0)
+              << "% of " << total.shadow_occluded << " occluded rays\n";
+}
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "Include/streamRender.h"
+#include "Include/imageStream.h"
+#include "Include/timing.h"
+
+static constexpr int STREAM_TAG = 1;
+
+static int bandRows(const RenderContext& ctx, int band) {
+    return std::min(STREAM_BAND_ROWS, ctx.height - band * STREAM_BAND_ROWS);
+}
+
+bool RenderStreamed(RenderContext& ctx, const std::string& fname, MPI_Comm comm) {
+    int rank = 0, size = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    PixelFormat format = PixelFormatFor(fname);
+    int n_bands = (ctx.height + STREAM_BAND_ROWS - 1) / STREAM_BAND_ROWS;
+
+    if (rank != 0) {
+        // Ring of band buffers; a slot is reused once its send completed
+        std::vector<std::unique_ptr<Framebuffer>> slots(STREAM_SEND_WINDOW);
+        std::vector<MPI_Request> sends(STREAM_SEND_WINDOW, MPI_REQUEST_NULL);
+
+        int k = 0;
+        for (int b = rank; b < n_bands; b += size, ++k) {
+            int s = k % STREAM_SEND_WINDOW;
+            {
+                PhaseScope wait(Phase::Wait, "wait send");
+                MPI_Wait(&sends[s], MPI_STATUS_IGNORE);
+            }
+            if (!slots[s]) slots[s].reset(new Framebuffer(ctx.width, STREAM_BAND_ROWS, format));
+
+            int rows = bandRows(ctx, b);
+            RenderRows(ctx, b * STREAM_BAND_ROWS, rows, *slots[s], 0);
+            MPI_Isend(slots[s]->data, static_cast<int>(rows * slots[s]->rowBytes()), MPI_BYTE,
+                      0, STREAM_TAG, comm, &sends[s]);
+        }
+        PhaseScope wait(Phase::Wait, "wait send");
+        MPI_Waitall(STREAM_SEND_WINDOW, sends.data(), MPI_STATUSES_IGNORE);
+        return true;
+    }
+
+    PhaseScope phase(Phase::Write);
+    std::unique_ptr<ImageStream> out = OpenImageStream(fname.c_str(), ctx.width, ctx.height);
+    bool ok = out != nullptr;
+
+    // One posted receive per rank, for the next band it will send.
+    // Messages between a pair of ranks arrive in send order.
+    std::vector<std::unique_ptr<Framebuffer>> inbox(size);
+    std::vector<MPI_Request> recvs(size, MPI_REQUEST_NULL);
+    auto postRecv = [&](int r, int band) {
+        if (band >= n_bands) return;
+        if (!inbox[r]) inbox[r].reset(new Framebuffer(ctx.width, STREAM_BAND_ROWS, format));
+        MPI_Irecv(inbox[r]->data, static_cast<int>(bandRows(ctx, band) * inbox[r]->rowBytes()),
+                  MPI_BYTE, r, STREAM_TAG, comm, &recvs[r]);
+    };
+    for (int r = 1; r < size; ++r) postRecv(r, r);
+
+    Framebuffer own(ctx.width, STREAM_BAND_ROWS, format);
+    int own_band = -1;   // band traced ahead into own, not yet written
+
+    for (int b = 0; b < n_bands; ++b) {
+        int owner = b % size;
+        int rows  = bandRows(ctx, b);
+
+        if (owner == 0) {
+            if (own_band != b) RenderRows(ctx, b * STREAM_BAND_ROWS, rows, own, 0);
+            own_band = -1;
+            ok = ok && out->writeRows(own.data, rows);
+            continue;
+        }
+
+        // Trace rank 0's next band instead of idling on one still in flight
+        int arrived = 0;
+        MPI_Test(&recvs[owner], &arrived, MPI_STATUS_IGNORE);
+        int next_own = (b / size + 1) * size;
+        if (!arrived && own_band < 0 && next_own < n_bands) {
+            RenderRows(ctx, next_own * STREAM_BAND_ROWS, bandRows(ctx, next_own), own, 0);
+            own_band = next_own;
+        }
+
+        {
+            PhaseScope wait(Phase::Wait, "wait recv", b * STREAM_BAND_ROWS);
+            MPI_Wait(&recvs[owner], MPI_STATUS_IGNORE);
+        }
+        ok = ok && out->writeRows(inbox[owner]->data, rows);
+        postRecv(owner, b + size);
+    }
+
+    if (out) ok = out->close() && ok;
+    return ok;
+}
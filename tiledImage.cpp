@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "Include/tiledImage.h"
+#include "Include/pngWriter.h"
+#include "Include/timing.h"
+
+bool IsTiledFormat(const std::string& fname) {
+    const std::string ext = ".tiles";
+    return fname.size() >= ext.size()
+        && fname.compare(fname.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+static std::string previewName(const std::string& fname) {
+    return fname.substr(0, fname.size() - 6) + "_preview.png";
+}
+
+// Box-filter one traced tile row (rows x width RGBA8) into preview rows
+static void downsampleBand(const Framebuffer& band, int rows, int factor,
+                           int preview_width, uint8_t* out) {
+    int preview_rows = (rows + factor - 1) / factor;
+    for (int py = 0; py < preview_rows; ++py) {
+        int y0 = py * factor, y1 = std::min(rows, y0 + factor);
+        for (int px = 0; px < preview_width; ++px) {
+            int x0 = px * factor, x1 = std::min(band.width, x0 + factor);
+            uint32_t sum[4] = {};
+            for (int y = y0; y < y1; ++y) {
+                const uint8_t* p = band.row(y) + static_cast<size_t>(x0) * 4;
+                for (int x = x0; x < x1; ++x, p += 4) {
+                    for (int c = 0; c < 4; ++c) sum[c] += p[c];
+                }
+            }
+            uint32_t n = static_cast<uint32_t>((y1 - y0) * (x1 - x0));
+            uint8_t* q = out + (static_cast<size_t>(py) * preview_width + px) * 4;
+            for (int c = 0; c < 4; ++c) q[c] = static_cast<uint8_t>((sum[c] + n / 2) / n);
+        }
+    }
+}
+
+bool RenderTiled(RenderContext& ctx, const std::string& fname,
+                 int preview_size, MPI_Comm comm) {
+    PhaseScope phase(Phase::Write);
+    int rank = 0, size = 1;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    const int T = TILED_TILE_SIZE;
+    const int W = ctx.width, H = ctx.height;
+    const int tiles_x = (W + T - 1) / T;
+    const int tiles_y = (H + T - 1) / T;
+    const size_t row_bytes = static_cast<size_t>(W) * 4;
+
+    // Every tile row but the last is full height, so offsets follow from
+    // the tile row alone
+    const MPI_Offset data_start = sizeof(TiledHeader)
+        + sizeof(TiledIndexEntry) * static_cast<MPI_Offset>(tiles_x) * tiles_y;
+    auto tileRowOffset = [&](int ty) {
+        return data_start + static_cast<MPI_Offset>(ty) * T * row_bytes;
+    };
+
+    // Contiguous block of tile rows per rank (first few ranks get +1)
+    int base = tiles_y / size, remainder = tiles_y % size;
+    auto firstTileRow = [&](int r) { return r * base + std::min(r, remainder); };
+    int t0 = firstTileRow(rank), t1 = firstTileRow(rank + 1);
+
+    // Preview: power-of-two box filter that divides the tile size
+    int factor = 1;
+    if (preview_size > 0) {
+        while (factor < T && (std::max(W, H) + factor - 1) / factor > preview_size) factor *= 2;
+    }
+    const int preview_w = (W + factor - 1) / factor;
+    const int preview_h = (H + factor - 1) / factor;
+    auto previewRow = [&](int ty) { return std::min(preview_h, ty * (T / factor)); };
+    const size_t preview_row_bytes = static_cast<size_t>(preview_w) * 4;
+    std::vector<uint8_t> preview;
+    if (preview_size > 0) preview.resize((previewRow(t1) - previewRow(t0)) * preview_row_bytes);
+
+    MPI_File fh;
+    if (MPI_File_open(comm, fname.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        return false;   // MPI_File_open is collective: all ranks fail
+    }
+    int ok = MPI_File_set_size(fh, data_start + static_cast<MPI_Offset>(H) * row_bytes)
+             == MPI_SUCCESS;
+
+    if (rank == 0) {
+        std::vector<uint8_t> head(data_start);
+        TiledHeader header = {};
+        memcpy(header.magic, "RTTILES1", 8);
+        header.width = W;
+        header.height = H;
+        header.tile_size = T;
+        header.tiles_x = tiles_x;
+        header.tiles_y = tiles_y;
+        header.pixel_bytes = 4;
+        memcpy(head.data(), &header, sizeof(header));
+
+        TiledIndexEntry* index = reinterpret_cast<TiledIndexEntry*>(head.data() + sizeof(header));
+        for (int ty = 0; ty < tiles_y; ++ty) {
+            int rows = std::min(T, H - ty * T);
+            for (int tx = 0; tx < tiles_x; ++tx) {
+                int cols = std::min(T, W - tx * T);
+                TiledIndexEntry& e = index[static_cast<size_t>(ty) * tiles_x + tx];
+                e.offset = tileRowOffset(ty) + static_cast<MPI_Offset>(rows) * tx * T * 4;
+                e.bytes  = static_cast<uint64_t>(rows) * cols * 4;
+            }
+        }
+        ok = ok && MPI_File_write_at(fh, 0, head.data(), static_cast<int>(head.size()),
+                                     MPI_BYTE, MPI_STATUS_IGNORE) == MPI_SUCCESS;
+    }
+
+    // Count rows rather than bytes so a tile row fits in an int count
+    MPI_Datatype row_type;
+    MPI_Type_contiguous(static_cast<int>(row_bytes), MPI_BYTE, &row_type);
+    MPI_Type_commit(&row_type);
+
+    Framebuffer band(W, T, PixelFormat::RGBA8);
+    std::vector<uint8_t> packed(T * row_bytes);
+
+    for (int ty = t0; ty < t1; ++ty) {
+        int rows = std::min(T, H - ty * T);
+        RenderRows(ctx, ty * T, rows, band, 0);
+
+        // Reorder the tile row into tile-major order
+        uint8_t* out = packed.data();
+        for (int tx = 0; tx < tiles_x; ++tx) {
+            size_t tile_row_bytes = static_cast<size_t>(std::min(T, W - tx * T)) * 4;
+            for (int y = 0; y < rows; ++y, out += tile_row_bytes) {
+                memcpy(out, band.row(y) + static_cast<size_t>(tx) * T * 4, tile_row_bytes);
+            }
+        }
+        {
+            PhaseScope phase(Phase::Write, "write tile row", ty * T);
+            ok = ok && MPI_File_write_at(fh, tileRowOffset(ty), packed.data(), rows, row_type,
+                                         MPI_STATUS_IGNORE) == MPI_SUCCESS;
+        }
+
+        if (preview_size > 0) {
+            downsampleBand(band, rows, factor, preview_w,
+                           preview.data() + (previewRow(ty) - previewRow(t0)) * preview_row_bytes);
+        }
+    }
+
+    MPI_Type_free(&row_type);
+    ok = MPI_File_close(&fh) == MPI_SUCCESS && ok;
+
+    if (preview_size > 0) {
+        MPI_Datatype preview_row;
+        MPI_Type_contiguous(static_cast<int>(preview_row_bytes), MPI_BYTE, &preview_row);
+        MPI_Type_commit(&preview_row);
+
+        std::vector<int> counts(size), displs(size);
+        for (int r = 0; r < size; ++r) {
+            displs[r] = previewRow(firstTileRow(r));
+            counts[r] = previewRow(firstTileRow(r + 1)) - displs[r];
+        }
+        std::vector<uint8_t> full(rank == 0 ? preview_h * preview_row_bytes : 0);
+        {
+            PhaseScope gather(Phase::Gather);
+            MPI_Gatherv(preview.data(), counts[rank], preview_row,
+                        full.data(), counts.data(), displs.data(), preview_row, 0, comm);
+        }
+        MPI_Type_free(&preview_row);
+
+        if (rank == 0) {
+            ok = WritePngParallel(previewName(fname).c_str(), full.data(),
+                                  preview_w, preview_h) && ok;
+        }
+    }
+
+    int all_ok = 0;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_LAND, comm);
+    return all_ok != 0;
+}
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include "Include/timing.h"
+#include "Include/stats.h"
+
+PhaseTiming g_timing;
+
+void StartPhaseTiming() {
+    g_timing = PhaseTiming();
+    g_timing.since = MPI_Wtime();
+}
+
+void ReportPhaseTiming(int world_rank) {
+    int size = 1;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // Close the current phase so every rank reports up to this point
+    g_timing.switchTo(g_timing.current);
+
+    // Per rank: phase times, then the total and the rays traced
+    constexpr int N = PHASE_COUNT + 2;
+    double local[N];
+    double total = 0.0;
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        local[p] = g_timing.ms[p];
+        total += g_timing.ms[p];
+    }
+    local[PHASE_COUNT] = total;
+    local[PHASE_COUNT + 1] = static_cast<double>(g_stats.primary_rays + g_stats.reflection_rays
+                                                 + g_stats.refraction_rays + g_stats.shadow_rays);
+
+    std::vector<double> all(world_rank == 0 ? static_cast<size_t>(N) * size : 0);
+    MPI_Gather(local, N, MPI_DOUBLE, all.data(), N, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (world_rank != 0) return;
+
+    struct Summary { double min, mean, max; int max_rank; };
+    auto summarize = [&](int column) {
+        Summary s = { all[column], 0.0, all[column], 0 };
+        for (int r = 0; r < size; ++r) {
+            double v = all[static_cast<size_t>(r) * N + column];
+            s.min = std::min(s.min, v);
+            s.mean += v / size;
+            if (v > s.max) { s.max = v; s.max_rank = r; }
+        }
+        return s;
+    };
+
+    const int TRACE = static_cast<int>(Phase::Trace);
+    Summary trace = summarize(TRACE);
+    double imbalance = trace.mean > 0.0 ? trace.max / trace.mean : 1.0;
+
+    double rays = 0.0, per_rank = 0.0;
+    for (int r = 0; r < size; ++r) {
+        double rays_r  = all[static_cast<size_t>(r) * N + PHASE_COUNT + 1];
+        double trace_r = all[static_cast<size_t>(r) * N + TRACE];
+        rays += rays_r;
+        if (trace_r > 0.0) per_rank += rays_r / (trace_r * 1e3) / size;
+    }
+    double mrays = trace.max > 0.0 ? rays / (trace.max * 1e3) : 0.0;
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "[TIMING] phase        min ms      mean ms       max ms  (rank)\n";
+    for (int column = 0; column <= PHASE_COUNT; ++column) {
+        const char* name = column < PHASE_COUNT ? PHASE_NAMES[column] : "total";
+        Summary s = summarize(column);
+        std::cout << "[TIMING] " << std::left << std::setw(8) << name << std::right
+                  << std::setw(12) << s.min << std::setw(13) << s.mean
+                  << std::setw(13) << s.max << "  (" << s.max_rank << ")\n";
+    }
+    std::cout << "[TIMING] trace imbalance (max/mean): " << imbalance << "\n";
+#ifdef RT_NO_STATS
+    const char* counted = "primary only, RT_NO_STATS";
+#else
+    const char* counted = "primary, secondary, shadow";
+#endif
+    std::cout << "[TIMING] rays (" << counted << "): " << static_cast<uint64_t>(rays)
+              << ", " << mrays << " Mrays/s (" << per_rank << " per rank)\n";
+
+    // Machine-readable summary on one line
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3);
+    json << "{\"ranks\":" << size << ",\"phases\":{";
+    for (int column = 0; column <= PHASE_COUNT; ++column) {
+        const char* name = column < PHASE_COUNT ? PHASE_NAMES[column] : "total";
+        Summary s = summarize(column);
+        json << (column ? "," : "") << "\"" << name << "\":{\"min\":" << s.min
+             << ",\"mean\":" << s.mean << ",\"max\":" << s.max
+             << ",\"max_rank\":" << s.max_rank << ",\"per_rank\":[";
+        for (int r = 0; r < size; ++r) {
+            json << (r ? "," : "") << all[static_cast<size_t>(r) * N + column];
+        }
+        json << "]}";
+    }
+    json << "},\"trace_imbalance\":" << imbalance
+         << ",\"rays\":" << static_cast<uint64_t>(rays)
+         << ",\"mrays_per_s\":" << mrays
+         << ",\"mrays_per_s_per_rank\":" << per_rank << "}";
+    std::cout << "[TIMING][JSON] " << json.str() << "\n";
+}
+
+// ----------------- Timeline trace -----------------
+
+bool g_tracing = false;
+
+static constexpr int TRACE_SYNC_TAG = 3;
+static constexpr int TRACE_SYNC_ROUNDS = 8;
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    double start, end;
+    int row;
+};
+
+struct ThreadTrace {
+    int tid;
+    std::vector<TraceEvent> events;
+};
+
+// Threads register their buffer on their first span; buffers outlive them
+static std::mutex g_trace_mutex;
+static std::vector<std::unique_ptr<ThreadTrace>> g_trace_threads;
+static thread_local ThreadTrace* t_trace = nullptr;
+
+static double g_trace_offset = 0.0;   // local clock + offset = rank 0's clock
+static double g_trace_origin = 0.0;   // rank 0's clock when the trace started
+
+void RecordSpan(const char* name, const char* category, double start, double end, int row) {
+    if (!t_trace) {
+        std::lock_guard<std::mutex> lock(g_trace_mutex);
+        g_trace_threads.emplace_back(new ThreadTrace{ static_cast<int>(g_trace_threads.size()), {} });
+        t_trace = g_trace_threads.back().get();
+    }
+    t_trace->events.push_back({ name, category, start, end, row });
+}
+
+void StartTrace() {
+    int rank = 0, size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // Ping-pong with rank 0; the round trip with the least delay gives
+    // the best estimate of rank 0's clock at its midpoint
+    if (rank == 0) {
+        for (int r = 1; r < size; ++r) {
+            for (int k = 0; k < TRACE_SYNC_ROUNDS; ++k) {
+                double now = 0.0;
+                MPI_Recv(&now, 1, MPI_DOUBLE, r, TRACE_SYNC_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                now = TraceClock();
+                MPI_Send(&now, 1, MPI_DOUBLE, r, TRACE_SYNC_TAG, MPI_COMM_WORLD);
+            }
+        }
+    } else {
+        double best = 1e30;
+        for (int k = 0; k < TRACE_SYNC_ROUNDS; ++k) {
+            double t1 = TraceClock(), remote = 0.0;
+            MPI_Send(&t1, 1, MPI_DOUBLE, 0, TRACE_SYNC_TAG, MPI_COMM_WORLD);
+            MPI_Recv(&remote, 1, MPI_DOUBLE, 0, TRACE_SYNC_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            double t2 = TraceClock();
+            if (t2 - t1 < best) {
+                best = t2 - t1;
+                g_trace_offset = remote - 0.5 * (t1 + t2);
+            }
+        }
+    }
+
+    g_trace_origin = TraceClock() + g_trace_offset;
+    MPI_Bcast(&g_trace_origin, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+    // The calling (main) thread gets track 0
+    double now = TraceClock();
+    RecordSpan("start trace", "other", now, now, -1);
+    g_tracing = true;
+}
+
+bool WriteTrace(const std::string& fname, int world_rank) {
+    if (!g_tracing) return true;
+    g_tracing = false;
+
+    int size = 1;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // This rank's events as comma-separated JSON objects; pid is the rank
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << world_rank
+        << ",\"args\":{\"name\":\"rank " << world_rank << "\"}}";
+    out << ",{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":" << world_rank
+        << ",\"args\":{\"sort_index\":" << world_rank << "}}";
+    {
+        std::lock_guard<std::mutex> lock(g_trace_mutex);
+        for (const std::unique_ptr<ThreadTrace>& t : g_trace_threads) {
+            out << ",{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << world_rank
+                << ",\"tid\":" << t->tid << ",\"args\":{\"name\":\""
+                << (t->tid == 0 ? "main" : "worker") << "\"}}";
+            for (const TraceEvent& e : t->events) {
+                double ts = (e.start + g_trace_offset - g_trace_origin) * 1e6;
+                out << ",{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category
+                    << "\",\"ph\":\"X\",\"pid\":" << world_rank << ",\"tid\":" << t->tid
+                    << ",\"ts\":" << ts << ",\"dur\":" << (e.end - e.start) * 1e6;
+                if (e.row >= 0) out << ",\"args\":{\"row\":" << e.row << "}";
+                out << "}";
+            }
+        }
+    }
+    std::string events = out.str();
+
+    int bytes = static_cast<int>(events.size());
+    std::vector<int> counts(size), displs(size);
+    MPI_Gather(&bytes, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    size_t total = 0;
+    for (int r = 0; r < size; ++r) {
+        displs[r] = static_cast<int>(total);
+        total += counts[r];
+    }
+
+    std::vector<char> all(world_rank == 0 ? total : 0);
+    MPI_Gatherv(events.data(), bytes, MPI_CHAR, all.data(), counts.data(), displs.data(),
+                MPI_CHAR, 0, MPI_COMM_WORLD);
+    if (world_rank != 0) return true;
+
+    FILE* f = fopen(fname.c_str(), "wb");
+    if (!f) return false;
+    bool ok = fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f) >= 0;
+    for (int r = 0; r < size && ok; ++r) {
+        if (r > 0) ok = fputs(",\n", f) >= 0;
+        ok = ok && fwrite(all.data() + displs[r], 1, counts[r], f) == static_cast<size_t>(counts[r]);
+    }
+    ok = ok && fputs("\n]}\n", f) >= 0;
+    return fclose(f) == 0 && ok;
+}